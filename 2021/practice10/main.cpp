@@ -27,6 +27,9 @@
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtx/string_cast.hpp>
 
+#include "pose.hpp"
+#include "pose_player.hpp"
+
 std::string to_string(std::string_view str)
 {
 	return std::string(str.begin(), str.end());
@@ -72,11 +75,26 @@ vec3 quat_rotate(vec4 q, vec3 v)
 	return quat_mult(q, quat_mult(vec4(0.0, v), quat_conj(q))).yzw;
 }
 
+// Global transforms of the bones, rotations are stored as (w, x, y, z)
+uniform vec4 bone_rotation[64];
+uniform vec3 bone_translation[64];
+uniform float bone_scale[64];
+
+vec3 bone_transform(int id, vec3 v)
+{
+	return bone_scale[id] * quat_rotate(bone_rotation[id], v) + bone_translation[id];
+}
+
 void main()
 {
-	gl_Position = projection * view * model * vec4(in_position, 1.0);
-	position = (model * vec4(in_position, 1.0)).xyz;
-	normal = normalize((model * vec4(in_normal, 0.0)).xyz);
+	vec3 skinned_position = in_bone_weight.x * bone_transform(in_bone_id.x, in_position)
+		+ in_bone_weight.y * bone_transform(in_bone_id.y, in_position);
+	vec3 skinned_normal = in_bone_weight.x * quat_rotate(bone_rotation[in_bone_id.x], in_normal)
+		+ in_bone_weight.y * quat_rotate(bone_rotation[in_bone_id.y], in_normal);
+
+	gl_Position = projection * view * model * vec4(skinned_position, 1.0);
+	position = (model * vec4(skinned_position, 1.0)).xyz;
+	normal = normalize((model * vec4(skinned_normal, 0.0)).xyz);
 }
 )";
 
@@ -162,18 +180,6 @@ struct bone
 	glm::quat rotation;
 };
 
-struct bone_pose
-{
-	glm::quat rotation = glm::quat(1.f, 0.f, 0.f, 0.f);
-	float scale = 1.f;
-	glm::vec3 translation = glm::vec3(0.f, 0.f, 0.f);
-};
-
-bone_pose operator * (bone_pose const & p1, bone_pose const & p2)
-{
-	return {p1.rotation * p2.rotation, p1.scale * p2.scale, p1.scale * glm::rotate(p1.rotation, p2.translation) + p1.translation};
-}
-
 int main() try
 {
 	if (SDL_Init(SDL_INIT_VIDEO) != 0)
@@ -226,6 +232,10 @@ int main() try
 	GLuint light_direction_location = glGetUniformLocation(program, "light_direction");
 	GLuint light_color_location = glGetUniformLocation(program, "light_color");
 
+	GLuint bone_rotation_location = glGetUniformLocation(program, "bone_rotation");
+	GLuint bone_translation_location = glGetUniformLocation(program, "bone_translation");
+	GLuint bone_scale_location = glGetUniformLocation(program, "bone_scale");
+
 	std::vector<vertex> vertices;
 	std::vector<std::uint32_t> indices;
 	std::vector<bone> bones;
@@ -253,6 +263,9 @@ int main() try
 		file.read((char*)(bones.data()), bones.size() * sizeof(bones[0]));
 	}
 
+	if (bones.size() > 64)
+		throw std::runtime_error("Too many bones for the shader: " + std::to_string(bones.size()));
+
 	for (std::size_t i = 0; i < 6; ++i)
 	{
 		std::ifstream file(PRACTICE_SOURCE_DIRECTORY "/pose_" + std::to_string(i) + ".bin", std::ios::binary);
@@ -261,6 +274,30 @@ int main() try
 		file.read((char*)(poses[i].data()), poses[i].size() * sizeof(poses[i][0]));
 	}
 
+	// Keys 1 to 6 fade into one of the poses, 0 into a clip going through all of them
+	std::vector<pose_clip> clips;
+	pose_clip all_poses;
+	for (std::size_t i = 0; i < poses.size(); ++i)
+	{
+		clips.push_back({{0.f}, {skeleton_pose(poses[i])}});
+
+		all_poses.times.push_back(i);
+		all_poses.keys.push_back(clips.back().keys[0]);
+	}
+	all_poses.times.push_back(poses.size());
+	all_poses.keys.push_back(all_poses.keys.front());
+	clips.push_back(std::move(all_poses));
+
+	pose_player player;
+	player.play(clips[0], 0.f);
+
+	skeleton_pose current_pose;
+
+	std::vector<bone_pose> global_pose(bones.size());
+	std::vector<glm::vec4> bone_rotations(bones.size());
+	std::vector<glm::vec3> bone_translations(bones.size());
+	std::vector<float> bone_scales(bones.size());
+
 	std::cout << "Loaded " << vertices.size() << " vertices, " << indices.size() << " indices, " << bones.size() << " bones" << std::endl;
 
 	GLuint vao, vbo, ebo;
@@ -317,6 +354,10 @@ int main() try
 			break;
 		case SDL_KEYDOWN:
 			button_down[event.key.keysym.sym] = true;
+			if (event.key.keysym.sym >= SDLK_1 && event.key.keysym.sym <= SDLK_6)
+				player.play(clips[event.key.keysym.sym - SDLK_1], 0.5f);
+			if (event.key.keysym.sym == SDLK_0)
+				player.play(clips.back(), 0.5f);
 			break;
 		case SDL_KEYUP:
 			button_down[event.key.keysym.sym] = false;
@@ -331,6 +372,22 @@ int main() try
 		last_frame_start = now;
 		time += dt;
 
+		player.update(dt);
+		player.evaluate(current_pose);
+
+		// The poses are relative to the parent bone, their composition moves the
+		// vertices from the bind pose in the model space; parents go first
+		for (std::size_t i = 0; i < bones.size(); ++i)
+		{
+			bone_pose const local = current_pose.bone(i);
+			global_pose[i] = bones[i].parent_id == -1 ? local : global_pose[bones[i].parent_id] * local;
+
+			glm::quat const & rotation = global_pose[i].rotation;
+			bone_rotations[i] = glm::vec4(rotation.w, rotation.x, rotation.y, rotation.z);
+			bone_translations[i] = global_pose[i].translation;
+			bone_scales[i] = global_pose[i].scale;
+		}
+
 		if (button_down[SDLK_UP])
 			camera_distance -= 3.f * dt;
 		if (button_down[SDLK_DOWN])
@@ -371,6 +428,10 @@ int main() try
 		glUniform3f(light_direction_location, 1.f / std::sqrt(3.f), 1.f / std::sqrt(3.f), 1.f / std::sqrt(3.f));
 		glUniform3f(light_color_location, 0.8f, 0.3f, 0.f);
 
+		glUniform4fv(bone_rotation_location, bones.size(), reinterpret_cast<float *>(bone_rotations.data()));
+		glUniform3fv(bone_translation_location, bones.size(), reinterpret_cast<float *>(bone_translations.data()));
+		glUniform1fv(bone_scale_location, bones.size(), bone_scales.data());
+
 		glBindVertexArray(vao);
 		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, nullptr);
 
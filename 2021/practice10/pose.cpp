@@ -0,0 +1,228 @@
+#include "pose.hpp"
+
+#include <glm/gtx/quaternion.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+bone_pose operator * (bone_pose const & p1, bone_pose const & p2)
+{
+	return {p1.rotation * p2.rotation, p1.scale * p2.scale, p1.scale * glm::rotate(p1.rotation, p2.translation) + p1.translation};
+}
+
+skeleton_pose::skeleton_pose(std::vector<bone_pose> const & bones)
+{
+	resize(bones.size());
+	for (std::size_t i = 0; i < bones.size(); ++i)
+	{
+		rotation_x[i] = bones[i].rotation.x;
+		rotation_y[i] = bones[i].rotation.y;
+		rotation_z[i] = bones[i].rotation.z;
+		rotation_w[i] = bones[i].rotation.w;
+		scale[i] = bones[i].scale;
+		translation_x[i] = bones[i].translation.x;
+		translation_y[i] = bones[i].translation.y;
+		translation_z[i] = bones[i].translation.z;
+	}
+}
+
+void skeleton_pose::resize(std::size_t size)
+{
+	rotation_x.resize(size, 0.f);
+	rotation_y.resize(size, 0.f);
+	rotation_z.resize(size, 0.f);
+	rotation_w.resize(size, 1.f);
+	scale.resize(size, 1.f);
+	translation_x.resize(size, 0.f);
+	translation_y.resize(size, 0.f);
+	translation_z.resize(size, 0.f);
+}
+
+bone_pose skeleton_pose::bone(std::size_t index) const
+{
+	return {
+		glm::quat(rotation_w[index], rotation_x[index], rotation_y[index], rotation_z[index]),
+		scale[index],
+		glm::vec3(translation_x[index], translation_y[index], translation_z[index]),
+	};
+}
+
+std::vector<bone_pose> skeleton_pose::bones() const
+{
+	std::vector<bone_pose> result(size());
+	for (std::size_t i = 0; i < result.size(); ++i)
+		result[i] = bone(i);
+	return result;
+}
+
+// Divides the rotations by their length, the loop is kept free of branches
+static void normalize_rotations(skeleton_pose & pose)
+{
+	std::size_t const size = pose.size();
+	float * x = pose.rotation_x.data();
+	float * y = pose.rotation_y.data();
+	float * z = pose.rotation_z.data();
+	float * w = pose.rotation_w.data();
+
+	for (std::size_t i = 0; i < size; ++i)
+	{
+		float const inverse_length = 1.f / std::sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i] + w[i] * w[i]);
+		x[i] *= inverse_length;
+		y[i] *= inverse_length;
+		z[i] *= inverse_length;
+		w[i] *= inverse_length;
+	}
+}
+
+// result += values * weight, one component at a time: loops over a single
+// output array are the ones the compiler reliably vectorizes
+static void accumulate(std::vector<float> & result, std::vector<float> const & values, float weight)
+{
+	float * out = result.data();
+	float const * in = values.data();
+	for (std::size_t i = 0; i < result.size(); ++i)
+		out[i] += in[i] * weight;
+}
+
+static void accumulate(std::vector<float> & result, std::vector<float> const & values, std::vector<float> const & weights)
+{
+	float * out = result.data();
+	float const * in = values.data();
+	float const * weight = weights.data();
+	for (std::size_t i = 0; i < result.size(); ++i)
+		out[i] += in[i] * weight[i];
+}
+
+void blend(std::span<skeleton_pose const * const> poses, std::span<float const> weights, skeleton_pose & result)
+{
+	assert(poses.size() == weights.size());
+	assert(!poses.empty());
+
+	std::size_t const size = poses[0]->size();
+	result.resize(size);
+
+	float total_weight = 0.f;
+	for (float weight : weights)
+		total_weight += weight;
+
+	if (total_weight <= 0.f)
+	{
+		result = *poses[0];
+		return;
+	}
+
+	std::fill(result.rotation_x.begin(), result.rotation_x.end(), 0.f);
+	std::fill(result.rotation_y.begin(), result.rotation_y.end(), 0.f);
+	std::fill(result.rotation_z.begin(), result.rotation_z.end(), 0.f);
+	std::fill(result.rotation_w.begin(), result.rotation_w.end(), 0.f);
+	std::fill(result.scale.begin(), result.scale.end(), 0.f);
+	std::fill(result.translation_x.begin(), result.translation_x.end(), 0.f);
+	std::fill(result.translation_y.begin(), result.translation_y.end(), 0.f);
+	std::fill(result.translation_z.begin(), result.translation_z.end(), 0.f);
+
+	skeleton_pose const & first = *poses[0];
+	std::vector<float> rotation_weights(size);
+
+	for (std::size_t p = 0; p < poses.size(); ++p)
+	{
+		skeleton_pose const & pose = *poses[p];
+		assert(pose.size() == size);
+
+		float const weight = weights[p] / total_weight;
+
+		// q and -q are the same rotation, take the one closer to the first pose
+		{
+			float const * fx = first.rotation_x.data();
+			float const * fy = first.rotation_y.data();
+			float const * fz = first.rotation_z.data();
+			float const * fw = first.rotation_w.data();
+			float const * px = pose.rotation_x.data();
+			float const * py = pose.rotation_y.data();
+			float const * pz = pose.rotation_z.data();
+			float const * pw = pose.rotation_w.data();
+			float * out = rotation_weights.data();
+
+			for (std::size_t i = 0; i < size; ++i)
+			{
+				float const dot = fx[i] * px[i] + fy[i] * py[i] + fz[i] * pz[i] + fw[i] * pw[i];
+				out[i] = dot < 0.f ? -weight : weight;
+			}
+		}
+
+		accumulate(result.rotation_x, pose.rotation_x, rotation_weights);
+		accumulate(result.rotation_y, pose.rotation_y, rotation_weights);
+		accumulate(result.rotation_z, pose.rotation_z, rotation_weights);
+		accumulate(result.rotation_w, pose.rotation_w, rotation_weights);
+		accumulate(result.scale, pose.scale, weight);
+		accumulate(result.translation_x, pose.translation_x, weight);
+		accumulate(result.translation_y, pose.translation_y, weight);
+		accumulate(result.translation_z, pose.translation_z, weight);
+	}
+
+	normalize_rotations(result);
+}
+
+void blend(skeleton_pose const & p1, skeleton_pose const & p2, float t, skeleton_pose & result)
+{
+	skeleton_pose const * poses[2] = {&p1, &p2};
+	float const weights[2] = {1.f - t, t};
+	blend(poses, weights, result);
+}
+
+void make_additive(skeleton_pose const & pose, skeleton_pose const & reference, skeleton_pose & result)
+{
+	std::size_t const size = pose.size();
+	assert(reference.size() == size);
+	result.resize(size);
+
+	for (std::size_t i = 0; i < size; ++i)
+	{
+		// conjugate(reference) * pose, reference rotations are unit
+		float const rx = -reference.rotation_x[i], ry = -reference.rotation_y[i], rz = -reference.rotation_z[i], rw = reference.rotation_w[i];
+		float const px = pose.rotation_x[i], py = pose.rotation_y[i], pz = pose.rotation_z[i], pw = pose.rotation_w[i];
+
+		result.rotation_x[i] = rw * px + rx * pw + ry * pz - rz * py;
+		result.rotation_y[i] = rw * py - rx * pz + ry * pw + rz * px;
+		result.rotation_z[i] = rw * pz + rx * py - ry * px + rz * pw;
+		result.rotation_w[i] = rw * pw - rx * px - ry * py - rz * pz;
+
+		result.scale[i] = pose.scale[i] / reference.scale[i];
+		result.translation_x[i] = pose.translation_x[i] - reference.translation_x[i];
+		result.translation_y[i] = pose.translation_y[i] - reference.translation_y[i];
+		result.translation_z[i] = pose.translation_z[i] - reference.translation_z[i];
+	}
+}
+
+void add(skeleton_pose & base, skeleton_pose const & additive, float weight)
+{
+	std::size_t const size = base.size();
+	assert(additive.size() == size);
+
+	for (std::size_t i = 0; i < size; ++i)
+	{
+		// Partial delta rotation: nlerp from identity, in the hemisphere of the identity
+		float const sign = additive.rotation_w[i] < 0.f ? -weight : weight;
+		float ax = additive.rotation_x[i] * sign;
+		float ay = additive.rotation_y[i] * sign;
+		float az = additive.rotation_z[i] * sign;
+		float aw = additive.rotation_w[i] * sign + (1.f - weight);
+		float const inverse_length = 1.f / std::sqrt(ax * ax + ay * ay + az * az + aw * aw);
+		ax *= inverse_length;
+		ay *= inverse_length;
+		az *= inverse_length;
+		aw *= inverse_length;
+
+		// base * delta
+		float const bx = base.rotation_x[i], by = base.rotation_y[i], bz = base.rotation_z[i], bw = base.rotation_w[i];
+		base.rotation_x[i] = bw * ax + bx * aw + by * az - bz * ay;
+		base.rotation_y[i] = bw * ay - bx * az + by * aw + bz * ax;
+		base.rotation_z[i] = bw * az + bx * ay - by * ax + bz * aw;
+		base.rotation_w[i] = bw * aw - bx * ax - by * ay - bz * az;
+
+		base.scale[i] *= 1.f + (additive.scale[i] - 1.f) * weight;
+		base.translation_x[i] += additive.translation_x[i] * weight;
+		base.translation_y[i] += additive.translation_y[i] * weight;
+		base.translation_z[i] += additive.translation_z[i] * weight;
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <span>
+#include <vector>
+
+// Local transform of a single bone, as stored in pose_*.bin
+struct bone_pose
+{
+	glm::quat rotation = glm::quat(1.f, 0.f, 0.f, 0.f);
+	float scale = 1.f;
+	glm::vec3 translation = glm::vec3(0.f, 0.f, 0.f);
+};
+
+bone_pose operator * (bone_pose const & p1, bone_pose const & p2);
+
+// Local transforms of all the bones, one array per scalar component, so that
+// every blending operation is a plain loop over floats that the compiler can
+// vectorize across bones
+struct skeleton_pose
+{
+	std::vector<float> rotation_x, rotation_y, rotation_z, rotation_w;
+	std::vector<float> scale;
+	std::vector<float> translation_x, translation_y, translation_z;
+
+	skeleton_pose() = default;
+	explicit skeleton_pose(std::vector<bone_pose> const & bones);
+
+	std::size_t size() const { return scale.size(); }
+
+	// New bones get the identity transform
+	void resize(std::size_t size);
+
+	bone_pose bone(std::size_t index) const;
+	std::vector<bone_pose> bones() const;
+};
+
+// Weighted blend of any number of poses of the same skeleton. Weights are
+// normalized, rotations are blended with normalized lerp after flipping each
+// quaternion into the hemisphere of the first pose. The result must not be
+// one of the blended poses.
+void blend(std::span<skeleton_pose const * const> poses, std::span<float const> weights, skeleton_pose & result);
+
+// Two-way blend, t = 0 gives p1 and t = 1 gives p2
+void blend(skeleton_pose const & p1, skeleton_pose const & p2, float t, skeleton_pose & result);
+
+// Difference between a pose and a reference one, such that applying it to the
+// reference gives the pose back: rotation and scale are relative, translation
+// is an offset
+void make_additive(skeleton_pose const & pose, skeleton_pose const & reference, skeleton_pose & result);
+
+// Applies an additive pose on top of base with a weight in [0, 1]
+void add(skeleton_pose & base, skeleton_pose const & additive, float weight);
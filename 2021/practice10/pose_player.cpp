@@ -0,0 +1,94 @@
+#include "pose_player.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+void sample(pose_clip const & clip, float time, skeleton_pose & result)
+{
+	assert(!clip.keys.empty() && clip.keys.size() == clip.times.size());
+
+	if (clip.keys.size() == 1)
+	{
+		result = clip.keys[0];
+		return;
+	}
+
+	float const duration = clip.duration();
+	if (clip.looping && duration > 0.f)
+	{
+		time = std::fmod(time, duration);
+		if (time < 0.f)
+			time += duration;
+	}
+	else
+		time = std::clamp(time, clip.times.front(), duration);
+
+	std::size_t const next = std::upper_bound(clip.times.begin(), clip.times.end(), time) - clip.times.begin();
+	if (next == 0 || next == clip.times.size())
+	{
+		result = clip.keys[std::min(next, clip.keys.size() - 1)];
+		return;
+	}
+
+	float const t = (time - clip.times[next - 1]) / (clip.times[next] - clip.times[next - 1]);
+	blend(clip.keys[next - 1], clip.keys[next], t, result);
+}
+
+void pose_player::play(pose_clip const & clip, float fade_duration)
+{
+	if (current.clip && fade_time < this->fade_duration)
+	{
+		// Interrupting a fade: the blend as it is now is faded out instead, so
+		// that neither of the clips it was made of pops out of the pose
+		skeleton_pose blended;
+		blend_clips(blended);
+		frozen_pose = std::move(blended);
+		previous_frozen = true;
+	}
+	else
+	{
+		previous = current;
+		previous_frozen = false;
+	}
+
+	current = {&clip, 0.f};
+
+	fade_time = 0.f;
+	this->fade_duration = (previous.clip || previous_frozen) ? fade_duration : 0.f;
+}
+
+void pose_player::update(float dt)
+{
+	current.time += dt;
+	previous.time += dt;
+	fade_time += dt;
+}
+
+void pose_player::blend_clips(skeleton_pose & result)
+{
+	if (fade_time < fade_duration)
+	{
+		sample(*current.clip, current.time, current_pose);
+		if (!previous_frozen)
+			sample(*previous.clip, previous.time, previous_pose);
+
+		// Smoothstep, so that the fade starts and ends without a jerk
+		float const t = fade_time / fade_duration;
+		blend(previous_frozen ? frozen_pose : previous_pose, current_pose, t * t * (3.f - 2.f * t), result);
+	}
+	else
+		sample(*current.clip, current.time, result);
+}
+
+void pose_player::evaluate(skeleton_pose & result)
+{
+	if (!current.clip)
+		return;
+
+	blend_clips(result);
+
+	if (additive && additive_weight > 0.f)
+		add(result, *additive, additive_weight);
+}
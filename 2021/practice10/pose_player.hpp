@@ -0,0 +1,64 @@
+#pragma once
+
+#include "pose.hpp"
+
+#include <vector>
+
+// Whole-skeleton poses at increasing times, a static pose is a clip with a
+// single key
+struct pose_clip
+{
+	std::vector<float> times;
+	std::vector<skeleton_pose> keys;
+	bool looping = true;
+
+	float duration() const { return times.empty() ? 0.f : times.back(); }
+};
+
+// Blends the two keys around time, wrapping it around for looping clips and
+// clamping it otherwise
+void sample(pose_clip const & clip, float time, skeleton_pose & result);
+
+// Plays one clip at a time and cross-fades into the next one when it changes.
+// Clips are referenced, not copied, and must outlive the player.
+class pose_player
+{
+public:
+	// Starts playing clip from the beginning, the previous one keeps playing
+	// while it is faded out over fade_duration seconds. Starting a new fade
+	// before the last one is over fades out of the blended pose of that moment,
+	// which stays still during the new fade.
+	void play(pose_clip const & clip, float fade_duration);
+
+	void update(float dt);
+
+	// Pose of the current frame, result must not be a pose owned by the player
+	void evaluate(skeleton_pose & result);
+
+	// Layer that is played on top of the clips with a weight, e.g. breathing
+	skeleton_pose const * additive = nullptr;
+	float additive_weight = 0.f;
+
+private:
+	struct track
+	{
+		pose_clip const * clip = nullptr;
+		float time = 0.f;
+	};
+
+	track current;
+	track previous;
+
+	float fade_time = 0.f;
+	float fade_duration = 0.f;
+
+	skeleton_pose current_pose;
+	skeleton_pose previous_pose;
+
+	// Replaces the previous clip when a fade was interrupted
+	skeleton_pose frozen_pose;
+	bool previous_frozen = false;
+
+	// The clips and the fade between them, without the additive layer
+	void blend_clips(skeleton_pose & result);
+};
@@ -0,0 +1,183 @@
+#include "animation_clip.hpp"
+
+#include <cassert>
+#include <cmath>
+
+animation_clip make_clip(gltf_model::animation const & animation, std::vector<bool> const & animated)
+{
+    animation_clip result;
+    result.bone_count = animation.bones.size();
+    result.duration = animation.max_time;
+
+    auto find_track = [&](auto const & spline) -> animation_clip::track &
+    {
+        for (auto & track : result.tracks)
+            if (track.mode == spline.mode && track.timestamps == spline.timestamps)
+                return track;
+
+        auto & track = result.tracks.emplace_back();
+        track.timestamps = spline.timestamps;
+        track.mode = spline.mode;
+        return track;
+    };
+
+    for (unsigned int bone = 0; bone < animation.bones.size(); ++bone)
+    {
+        auto const & bone_animation = animation.bones[bone];
+        bool const keep = animated.empty() || animated[bone];
+
+        if (!bone_animation.translation.values.empty())
+        {
+            auto & track = find_track(bone_animation.translation);
+            if (keep) track.translation_bones.push_back(bone);
+        }
+        if (!bone_animation.rotation.values.empty())
+        {
+            auto & track = find_track(bone_animation.rotation);
+            if (keep) track.rotation_bones.push_back(bone);
+        }
+        if (!bone_animation.scale.values.empty())
+        {
+            auto & track = find_track(bone_animation.scale);
+            if (keep) track.scale_bones.push_back(bone);
+        }
+    }
+
+    auto fill_rows = [&](auto & rows, std::vector<unsigned int> const & bones, std::size_t key_count, auto get_values)
+    {
+        rows.resize(key_count * bones.size());
+        for (std::size_t channel = 0; channel < bones.size(); ++channel)
+        {
+            auto const & values = get_values(animation.bones[bones[channel]]);
+            for (std::size_t key = 0; key < key_count; ++key)
+                rows[key * bones.size() + channel] = values[key];
+        }
+    };
+
+    for (auto & track : result.tracks)
+    {
+        std::size_t const key_count = track.timestamps.size();
+
+        fill_rows(track.translations, track.translation_bones, key_count, [](auto const & b) -> auto const & { return b.translation.values; });
+        fill_rows(track.rotations, track.rotation_bones, key_count, [](auto const & b) -> auto const & { return b.rotation.values; });
+        fill_rows(track.scales, track.scale_bones, key_count, [](auto const & b) -> auto const & { return b.scale.values; });
+
+        if (track.mode == gltf_model::interpolation::cubic_spline)
+        {
+            fill_rows(track.in_translations, track.translation_bones, key_count, [](auto const & b) -> auto const & { return b.translation.in_tangents; });
+            fill_rows(track.out_translations, track.translation_bones, key_count, [](auto const & b) -> auto const & { return b.translation.out_tangents; });
+            fill_rows(track.in_rotations, track.rotation_bones, key_count, [](auto const & b) -> auto const & { return b.rotation.in_tangents; });
+            fill_rows(track.out_rotations, track.rotation_bones, key_count, [](auto const & b) -> auto const & { return b.rotation.out_tangents; });
+            fill_rows(track.in_scales, track.scale_bones, key_count, [](auto const & b) -> auto const & { return b.scale.in_tangents; });
+            fill_rows(track.out_scales, track.scale_bones, key_count, [](auto const & b) -> auto const & { return b.scale.out_tangents; });
+        }
+
+        // Neighbouring keys are put into the same hemisphere, so that the
+        // sampler can blend them without checking for the shortest path.
+        // Cubic curves are taken as they are, their tangents depend on the signs.
+        if (track.mode == gltf_model::interpolation::cubic_spline)
+            continue;
+
+        std::size_t const count = track.rotation_bones.size();
+        for (std::size_t key = 1; key < key_count; ++key)
+            for (std::size_t channel = 0; channel < count; ++channel)
+            {
+                auto const & previous = track.rotations[(key - 1) * count + channel];
+                auto & current = track.rotations[key * count + channel];
+                if (glm::dot(previous, current) < 0.f)
+                    current = -current;
+            }
+    }
+
+    return result;
+}
+
+// Same row layout as in sample(), with the tangents scaled to the segment duration
+// folded into the basis; each loop runs over contiguous rows of floats
+static void sample_cubic(animation_clip::track const & track, std::size_t key0, std::size_t key1, glm::vec4 const & basis, pose & result)
+{
+    {
+        std::size_t const count = track.translation_bones.size();
+        glm::vec3 const * row0 = track.translations.data() + key0 * count;
+        glm::vec3 const * out0 = track.out_translations.data() + key0 * count;
+        glm::vec3 const * row1 = track.translations.data() + key1 * count;
+        glm::vec3 const * in1 = track.in_translations.data() + key1 * count;
+        for (std::size_t c = 0; c < count; ++c)
+            result.translation[track.translation_bones[c]] = spline_hermite(row0[c], out0[c], row1[c], in1[c], basis);
+    }
+
+    {
+        std::size_t const count = track.rotation_bones.size();
+        glm::quat const * row0 = track.rotations.data() + key0 * count;
+        glm::quat const * out0 = track.out_rotations.data() + key0 * count;
+        glm::quat const * row1 = track.rotations.data() + key1 * count;
+        glm::quat const * in1 = track.in_rotations.data() + key1 * count;
+        for (std::size_t c = 0; c < count; ++c)
+            result.rotation[track.rotation_bones[c]] = spline_hermite(row0[c], out0[c], row1[c], in1[c], basis);
+    }
+
+    {
+        std::size_t const count = track.scale_bones.size();
+        glm::vec3 const * row0 = track.scales.data() + key0 * count;
+        glm::vec3 const * out0 = track.out_scales.data() + key0 * count;
+        glm::vec3 const * row1 = track.scales.data() + key1 * count;
+        glm::vec3 const * in1 = track.in_scales.data() + key1 * count;
+        for (std::size_t c = 0; c < count; ++c)
+            result.scale[track.scale_bones[c]] = spline_hermite(row0[c], out0[c], row1[c], in1[c], basis);
+    }
+}
+
+void sample(animation_clip const & clip, float time, pose & result, std::vector<std::size_t> & cursors)
+{
+    assert(result.size() >= clip.bone_count);
+
+    cursors.resize(clip.tracks.size(), 0);
+
+    for (std::size_t i = 0; i < clip.tracks.size(); ++i)
+    {
+        auto const & track = clip.tracks[i];
+        std::size_t const key_count = track.timestamps.size();
+
+        // Rows of the two keys around time and the blend factor between them
+        std::size_t const key = find_key(track.timestamps, time, cursors[i]);
+        std::size_t const key1 = std::min(key, key_count - 1);
+        std::size_t const key0 = key == 0 ? 0 : key1 == key ? key - 1 : key1;
+        float const duration = track.timestamps[key1] - track.timestamps[key0];
+        float t = key0 == key1 ? 0.f : (time - track.timestamps[key0]) / duration;
+
+        if (track.mode == gltf_model::interpolation::cubic_spline && key0 != key1)
+        {
+            sample_cubic(track, key0, key1, hermite_basis(t) * glm::vec4(1.f, duration, 1.f, duration), result);
+            continue;
+        }
+
+        // The previous key up to the next one, t is 1 only exactly at it
+        if (track.mode == gltf_model::interpolation::step)
+            t = std::floor(t);
+
+        {
+            std::size_t const count = track.translation_bones.size();
+            glm::vec3 const * row0 = track.translations.data() + key0 * count;
+            glm::vec3 const * row1 = track.translations.data() + key1 * count;
+            for (std::size_t c = 0; c < count; ++c)
+                result.translation[track.translation_bones[c]] = row0[c] + (row1[c] - row0[c]) * t;
+        }
+
+        // Normalized lerp: the keys are dense enough for it to be indistinguishable from slerp
+        {
+            std::size_t const count = track.rotation_bones.size();
+            glm::quat const * row0 = track.rotations.data() + key0 * count;
+            glm::quat const * row1 = track.rotations.data() + key1 * count;
+            for (std::size_t c = 0; c < count; ++c)
+                result.rotation[track.rotation_bones[c]] = glm::normalize(row0[c] * (1.f - t) + row1[c] * t);
+        }
+
+        {
+            std::size_t const count = track.scale_bones.size();
+            glm::vec3 const * row0 = track.scales.data() + key0 * count;
+            glm::vec3 const * row1 = track.scales.data() + key1 * count;
+            for (std::size_t c = 0; c < count; ++c)
+                result.scale[track.scale_bones[c]] = row0[c] + (row1[c] - row0[c]) * t;
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "gltf_loader.hpp"
+#include "pose.hpp"
+
+#include <vector>
+
+// An animation rearranged for sampling the whole skeleton at once. Channels
+// that share a timeline are grouped into one track, so that a single key
+// search serves all of them, and the values of a track are stored row by row:
+// all the channels of key 0, then all the channels of key 1 and so on.
+struct animation_clip
+{
+    struct track
+    {
+        std::vector<float> timestamps;
+        gltf_model::interpolation mode = gltf_model::interpolation::linear;
+
+        // Bones animated by the track, for each kind of channel
+        std::vector<unsigned int> translation_bones;
+        std::vector<unsigned int> rotation_bones;
+        std::vector<unsigned int> scale_bones;
+
+        // translations[key * translation_bones.size() + channel] etc
+        std::vector<glm::vec3> translations;
+        std::vector<glm::quat> rotations;
+        std::vector<glm::vec3> scales;
+
+        // Tangents of cubic_spline tracks in the same layout, empty otherwise
+        std::vector<glm::vec3> in_translations, out_translations;
+        std::vector<glm::quat> in_rotations, out_rotations;
+        std::vector<glm::vec3> in_scales, out_scales;
+    };
+
+    std::vector<track> tracks;
+    std::size_t bone_count = 0;
+    float duration = 0.f;
+};
+
+// Only the bones marked in animated get channels, all of them if it is empty.
+// Tracks are kept even when all their channels are dropped, so that clips made
+// from the same animation always have the same tracks and can share cursors.
+animation_clip make_clip(gltf_model::animation const & animation, std::vector<bool> const & animated = {});
+
+// Writes the animated bones of the pose, the other bones are left as they are.
+// Time is clamped to the clip, cursors keep one key position per track between calls.
+void sample(animation_clip const & clip, float time, pose & result, std::vector<std::size_t> & cursors);
@@ -0,0 +1,203 @@
+#include "blend_tree.hpp"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cassert>
+
+// (instance, node) pairs handed to a thread at once
+static constexpr std::size_t nodes_per_job = 8;
+
+static unsigned int add_node(blend_tree & tree, blend_tree::node node)
+{
+    for (auto input : node.inputs)
+        assert(input == unsigned(-1) || input < tree.nodes.size());
+
+    node.parameter = tree.parameter_count++;
+    tree.nodes.push_back(node);
+    return tree.nodes.size() - 1;
+}
+
+unsigned int blend_tree::add_sample(unsigned int clip)
+{
+    return add_node(*this, {node_type::sample, clip});
+}
+
+unsigned int blend_tree::add_blend(unsigned int from, unsigned int to)
+{
+    return add_node(*this, {node_type::blend, 0, {from, to, unsigned(-1)}});
+}
+
+unsigned int blend_tree::add_additive(unsigned int base, unsigned int pose, unsigned int reference)
+{
+    return add_node(*this, {node_type::additive, 0, {base, pose, reference}});
+}
+
+compiled_blend_tree compile(blend_tree const & tree)
+{
+    std::size_t const count = tree.nodes.size();
+    assert(count > 0);
+
+    compiled_blend_tree result;
+    result.nodes = tree.nodes;
+    result.parameter_count = tree.parameter_count;
+
+    // Level of a node is one more than the deepest of its inputs
+    std::vector<unsigned int> levels(count, 0);
+    unsigned int level_count = 0;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        for (auto input : tree.nodes[i].inputs)
+            if (input != unsigned(-1))
+                levels[i] = std::max(levels[i], levels[input] + 1);
+        level_count = std::max(level_count, levels[i] + 1);
+    }
+
+    for (unsigned int level = 0; level < level_count; ++level)
+    {
+        result.level_begin.push_back(result.order.size());
+        for (unsigned int i = 0; i < count; ++i)
+            if (levels[i] == level)
+                result.order.push_back(i);
+    }
+    result.level_begin.push_back(result.order.size());
+
+    // Last level reading each node, the result is read after the last level
+    std::vector<unsigned int> last_use(count, 0);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        last_use[i] = levels[i];
+        for (auto input : tree.nodes[i].inputs)
+            if (input != unsigned(-1))
+                last_use[input] = std::max(last_use[input], levels[i]);
+    }
+    last_use[count - 1] = level_count;
+
+    // Buffers freed by a level only become available to the next one, since
+    // the nodes of a level run concurrently
+    result.buffers.assign(count, 0);
+    std::vector<unsigned int> free_buffers;
+    for (unsigned int level = 0; level < level_count; ++level)
+    {
+        for (std::size_t k = result.level_begin[level]; k < result.level_begin[level + 1]; ++k)
+        {
+            unsigned int const i = result.order[k];
+            if (free_buffers.empty())
+                result.buffers[i] = result.buffer_count++;
+            else
+            {
+                result.buffers[i] = free_buffers.back();
+                free_buffers.pop_back();
+            }
+        }
+
+        for (std::size_t i = 0; i < count; ++i)
+            if (levels[i] <= level && last_use[i] == level)
+                free_buffers.push_back(result.buffers[i]);
+    }
+
+    result.sample_index.assign(count, unsigned(-1));
+    for (std::size_t i = 0; i < count; ++i)
+        if (tree.nodes[i].type == blend_tree::node_type::sample)
+            result.sample_index[i] = result.sample_count++;
+
+    return result;
+}
+
+static glm::quat shortest_nlerp(glm::quat const & q1, glm::quat q2, float t)
+{
+    if (glm::dot(q1, q2) < 0.f)
+        q2 = -q2;
+    return glm::normalize(q1 * (1.f - t) + q2 * t);
+}
+
+static void evaluate_node(compiled_blend_tree const & tree, unsigned int index, std::vector<animation_clip> const & clips, pose const & rest_pose,
+    blend_tree_instance & instance, pose * buffers)
+{
+    auto const & node = tree.nodes[index];
+    float const parameter = instance.parameters[node.parameter];
+
+    pose & result = buffers[tree.buffers[index]];
+    std::size_t const bone_count = rest_pose.size();
+
+    auto input = [&](int k) -> pose const & { return buffers[tree.buffers[node.inputs[k]]]; };
+
+    switch (node.type)
+    {
+    case blend_tree::node_type::sample:
+    {
+        auto const & clip = clips[node.clip];
+        result = rest_pose;
+        sample(clip, parameter, result, instance.cursors[tree.sample_index[index]]);
+        break;
+    }
+    case blend_tree::node_type::blend:
+    {
+        pose const & from = input(0);
+        pose const & to = input(1);
+        result.resize(bone_count);
+        for (std::size_t bone = 0; bone < bone_count; ++bone)
+        {
+            result.translation[bone] = glm::mix(from.translation[bone], to.translation[bone], parameter);
+            result.rotation[bone] = shortest_nlerp(from.rotation[bone], to.rotation[bone], parameter);
+            result.scale[bone] = glm::mix(from.scale[bone], to.scale[bone], parameter);
+        }
+        break;
+    }
+    case blend_tree::node_type::additive:
+    {
+        pose const & base = input(0);
+        pose const & added = input(1);
+        pose const & reference = input(2);
+        result.resize(bone_count);
+        for (std::size_t bone = 0; bone < bone_count; ++bone)
+        {
+            glm::quat const difference = shortest_nlerp(glm::quat(1.f, 0.f, 0.f, 0.f), added.rotation[bone] * glm::inverse(reference.rotation[bone]), parameter);
+
+            result.translation[bone] = base.translation[bone] + (added.translation[bone] - reference.translation[bone]) * parameter;
+            result.rotation[bone] = glm::normalize(difference * base.rotation[bone]);
+            result.scale[bone] = base.scale[bone] * glm::mix(glm::vec3(1.f), added.scale[bone] / reference.scale[bone], parameter);
+        }
+        break;
+    }
+    }
+}
+
+void evaluate(compiled_blend_tree const & tree, std::vector<animation_clip> const & clips, pose const & rest_pose,
+    std::vector<blend_tree_instance> & instances, blend_arena & arena, std::vector<pose> & results, thread_pool & pool)
+{
+    std::size_t const instance_count = instances.size();
+
+    if (arena.buffers.size() < instance_count * tree.buffer_count)
+        arena.buffers.resize(instance_count * tree.buffer_count);
+
+    for (auto & instance : instances)
+    {
+        assert(instance.parameters.size() >= tree.parameter_count);
+        instance.cursors.resize(tree.sample_count);
+    }
+
+    for (std::size_t level = 0; level + 1 < tree.level_begin.size(); ++level)
+    {
+        std::size_t const begin = tree.level_begin[level];
+        std::size_t const width = tree.level_begin[level + 1] - begin;
+
+        // Nodes of the same instance go next to each other
+        pool.parallel_for(instance_count * width, nodes_per_job, [&](std::size_t job_begin, std::size_t job_end)
+        {
+            for (std::size_t job = job_begin; job < job_end; ++job)
+            {
+                std::size_t const i = job / width;
+                evaluate_node(tree, tree.order[begin + job % width], clips, rest_pose, instances[i], arena.buffers.data() + i * tree.buffer_count);
+            }
+        });
+    }
+
+    results.resize(instance_count);
+    unsigned int const output = tree.buffers[tree.nodes.size() - 1];
+    pool.parallel_for(instance_count, nodes_per_job, [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+            results[i] = arena.buffers[i * tree.buffer_count + output];
+    });
+}
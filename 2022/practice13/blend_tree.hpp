@@ -0,0 +1,90 @@
+#pragma once
+
+#include "animation_clip.hpp"
+#include "pose.hpp"
+#include "thread_pool.hpp"
+
+#include <array>
+#include <vector>
+
+// Pose computation as a graph of nodes, built once and evaluated for many
+// instances with their own parameters. Nodes can only take the nodes added
+// before them as inputs, the last node added is the result.
+struct blend_tree
+{
+    enum class node_type
+    {
+        // clips[clip] at the time given by the parameter, bones the clip
+        // doesn't animate stay in the rest pose
+        sample,
+        // inputs[0] mixed towards inputs[1] by the parameter
+        blend,
+        // inputs[0] plus the parameter times the difference between inputs[1]
+        // and inputs[2], the reference pose of the additive animation
+        additive,
+    };
+
+    struct node
+    {
+        node_type type;
+        unsigned int clip = 0;
+        std::array<unsigned int, 3> inputs{unsigned(-1), unsigned(-1), unsigned(-1)};
+        // Index into the parameters of an instance
+        unsigned int parameter = 0;
+    };
+
+    std::vector<node> nodes;
+    unsigned int parameter_count = 0;
+
+    // Each of these adds a node with a new parameter and returns its index
+    unsigned int add_sample(unsigned int clip);
+    unsigned int add_blend(unsigned int from, unsigned int to);
+    unsigned int add_additive(unsigned int base, unsigned int pose, unsigned int reference);
+};
+
+// The tree split into levels of nodes whose inputs are all on earlier levels,
+// so that all the nodes of a level can run at once, with the output of every
+// node assigned to a pose buffer. Buffers are reused once the last level
+// reading them is done.
+struct compiled_blend_tree
+{
+    std::vector<blend_tree::node> nodes;
+
+    // Nodes of level l are order[level_begin[l]] to order[level_begin[l + 1] - 1]
+    std::vector<unsigned int> order;
+    std::vector<std::size_t> level_begin;
+
+    std::vector<unsigned int> buffers;
+    unsigned int buffer_count = 0;
+
+    // Sample nodes are numbered for keeping their cursors
+    std::vector<unsigned int> sample_index;
+    unsigned int sample_count = 0;
+
+    unsigned int parameter_count = 0;
+};
+
+compiled_blend_tree compile(blend_tree const & tree);
+
+struct blend_tree_instance
+{
+    std::vector<float> parameters;
+
+    // Key search state of each sample node, doesn't affect the result
+    std::vector<std::vector<std::size_t>> cursors;
+};
+
+// Pose buffers of all the instances, buffers[instance * buffer_count + buffer].
+// Kept from frame to frame, so that evaluation doesn't allocate once the
+// number of instances stops growing.
+struct blend_arena
+{
+    std::vector<pose> buffers;
+};
+
+// Evaluates the tree for every instance into results. Each level is one
+// parallel loop over all the (instance, node) pairs of the level; a node only
+// reads the buffers of its inputs and writes its own, so the result is the
+// same for any number of threads.
+void evaluate(compiled_blend_tree const & tree, std::vector<animation_clip> const & clips, pose const & rest_pose,
+    std::vector<blend_tree_instance> & instances, blend_arena & arena, std::vector<pose> & results, thread_pool & pool);
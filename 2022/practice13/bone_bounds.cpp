@@ -0,0 +1,44 @@
+#include "bone_bounds.hpp"
+
+#include <glm/common.hpp>
+
+void add_bone_bounds(skinned_mesh const & mesh, std::vector<bounding_box> & bone_bounds)
+{
+    for (std::size_t i = 0; i < mesh.positions.size(); ++i)
+        for (int j = 0; j < 4; ++j)
+        {
+            if (mesh.weights[i][j] <= 0.f)
+                continue;
+
+            std::size_t const bone = mesh.joints[i][j];
+            if (bone >= bone_bounds.size())
+                bone_bounds.resize(bone + 1);
+            bone_bounds[bone].extend(mesh.positions[i]);
+        }
+}
+
+bounding_box posed_bounds(std::vector<bounding_box> const & bone_bounds, glm::mat4x3 const * palette)
+{
+    bounding_box result;
+
+    for (std::size_t bone = 0; bone < bone_bounds.size(); ++bone)
+    {
+        bounding_box const & box = bone_bounds[bone];
+        if (box.empty())
+            continue;
+
+        // The moved box is centered at the moved center, its half extent
+        // along each axis sums the absolute values of the matrix row
+        glm::mat4x3 const & m = palette[bone];
+        glm::vec3 const center = (box.min + box.max) * 0.5f;
+        glm::vec3 const half = (box.max - box.min) * 0.5f;
+
+        glm::vec3 const moved_center = m[0] * center.x + m[1] * center.y + m[2] * center.z + m[3];
+        glm::vec3 const moved_half = glm::abs(m[0]) * half.x + glm::abs(m[1]) * half.y + glm::abs(m[2]) * half.z;
+
+        result.extend(moved_center - moved_half);
+        result.extend(moved_center + moved_half);
+    }
+
+    return result;
+}
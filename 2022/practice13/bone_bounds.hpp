@@ -0,0 +1,19 @@
+#pragma once
+
+#include "bounding_box.hpp"
+#include "cpu_skinning.hpp"
+
+#include <glm/mat4x3.hpp>
+
+#include <vector>
+
+// Extends the bind pose box of every bone by the vertices of the mesh it has
+// a non-zero weight for; bones without vertices keep an empty box. Meshes
+// sharing a skin can be accumulated into the same boxes.
+void add_bone_bounds(skinned_mesh const & mesh, std::vector<bounding_box> & bone_bounds);
+
+// Box around the skinned mesh in the pose given by the palette, without
+// skinning it: a skinned vertex is a weighted average of the vertex moved by
+// each of its bones, so it stays inside the union of the moved bone boxes.
+// Exact for linear blend skinning, close for dual quaternions.
+bounding_box posed_bounds(std::vector<bounding_box> const & bone_bounds, glm::mat4x3 const * palette);
@@ -0,0 +1,127 @@
+#include "bone_palette.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+std::vector<std::uint32_t> read_triangles(gltf_model const & model, gltf_model::mesh const & mesh)
+{
+    if (mesh.mode != 4) // GL_TRIANGLES
+        throw std::runtime_error("Mesh " + mesh.name + " is not made of triangles");
+
+    std::vector<std::uint32_t> result;
+    if (mesh.indices)
+    {
+        // Indices are read as floats, exact up to 2^24 vertices
+        for (float index : read_accessor<float>(model, *mesh.indices))
+            result.push_back(index);
+    }
+    else
+    {
+        result.resize(mesh.position.count);
+        std::iota(result.begin(), result.end(), 0);
+    }
+    return result;
+}
+
+std::vector<skinned_submesh> split_by_bones(skinned_mesh const & mesh, std::vector<std::uint32_t> const & indices, std::size_t max_bones)
+{
+    std::size_t const triangle_count = indices.size() / 3;
+
+    std::size_t bone_count = 0;
+    for (auto const & joints : mesh.joints)
+        for (auto joint : joints)
+            bone_count = std::max<std::size_t>(bone_count, joint + 1);
+
+    // Sorted distinct bones with a non-zero weight of each triangle
+    std::vector<std::vector<std::uint16_t>> triangle_bones(triangle_count);
+    for (std::size_t t = 0; t < triangle_count; ++t)
+    {
+        auto & bones = triangle_bones[t];
+        for (int k = 0; k < 3; ++k)
+        {
+            std::uint32_t const v = indices[3 * t + k];
+            for (int j = 0; j < 4; ++j)
+                if (mesh.weights[v][j] > 0.f)
+                    bones.push_back(mesh.joints[v][j]);
+        }
+        std::sort(bones.begin(), bones.end());
+        bones.erase(std::unique(bones.begin(), bones.end()), bones.end());
+
+        if (bones.size() > max_bones)
+            throw std::runtime_error("A triangle uses " + std::to_string(bones.size()) + " bones, more than " + std::to_string(max_bones));
+    }
+
+    std::vector<skinned_submesh> result;
+    std::vector<bool> assigned(triangle_count, false);
+    std::size_t remaining = triangle_count;
+
+    // Palette slot of each bone and part vertex of each mesh vertex, -1 if
+    // not in the current part
+    std::vector<int> slots(bone_count, -1);
+    std::vector<std::uint32_t> part_vertices(mesh.positions.size(), -1);
+
+    for (std::size_t first = 0; remaining > 0;)
+    {
+        while (assigned[first])
+            ++first;
+
+        auto & part = result.emplace_back();
+
+        for (std::size_t t = first; t < triangle_count; ++t)
+        {
+            if (assigned[t])
+                continue;
+
+            std::size_t new_bones = 0;
+            for (auto bone : triangle_bones[t])
+                new_bones += slots[bone] == -1;
+            if (part.bones.size() + new_bones > max_bones)
+                continue;
+
+            for (auto bone : triangle_bones[t])
+                if (slots[bone] == -1)
+                {
+                    slots[bone] = part.bones.size();
+                    part.bones.push_back(bone);
+                }
+
+            for (int k = 0; k < 3; ++k)
+            {
+                std::uint32_t const v = indices[3 * t + k];
+                if (part_vertices[v] == std::uint32_t(-1))
+                {
+                    part_vertices[v] = part.vertices.size();
+                    part.vertices.push_back(v);
+                }
+                part.indices.push_back(part_vertices[v]);
+            }
+
+            assigned[t] = true;
+            --remaining;
+        }
+
+        part.joints.resize(part.vertices.size());
+        for (std::size_t i = 0; i < part.vertices.size(); ++i)
+        {
+            std::uint32_t const v = part.vertices[i];
+            for (int j = 0; j < 4; ++j)
+                part.joints[i][j] = mesh.weights[v][j] > 0.f ? slots[mesh.joints[v][j]] : 0;
+        }
+
+        for (auto bone : part.bones)
+            slots[bone] = -1;
+        for (auto v : part.vertices)
+            part_vertices[v] = -1;
+    }
+
+    return result;
+}
+
+void gather_palette(std::vector<std::uint16_t> const & bones, glm::mat4x3 const * palette, std::vector<glm::mat4x3> & result)
+{
+    result.resize(bones.size());
+    for (std::size_t i = 0; i < bones.size(); ++i)
+        result[i] = palette[bones[i]];
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "cpu_skinning.hpp"
+
+#include <glm/mat4x3.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Part of a skinned mesh that can be drawn with a palette of at most max_bones
+// matrices. Vertices shared with other parts are duplicated.
+struct skinned_submesh
+{
+    // Skeleton bone of each palette slot
+    std::vector<std::uint16_t> bones;
+
+    // Index of each vertex in the original mesh and its joints remapped to
+    // palette slots; zero weight joints point at slot 0
+    std::vector<std::uint32_t> vertices;
+    std::vector<std::array<std::uint16_t, 4>> joints;
+
+    // Triangles, indexing the vertices above
+    std::vector<std::uint32_t> indices;
+};
+
+// Indices of a triangle mesh, 0, 1, 2... for a non-indexed one
+std::vector<std::uint32_t> read_triangles(gltf_model const & model, gltf_model::mesh const & mesh);
+
+// Splits the triangles into parts referencing at most max_bones bones each.
+// Every part is grown greedily from the first remaining triangle, taking all
+// the triangles whose bones still fit; a mesh that fits is returned as a
+// single part with only the bones it uses. Throws if a single triangle has
+// more than max_bones bones.
+std::vector<skinned_submesh> split_by_bones(skinned_mesh const & mesh, std::vector<std::uint32_t> const & indices, std::size_t max_bones);
+
+// The slice of the full skeleton palette that a part with these bones needs,
+// in slot order
+void gather_palette(std::vector<std::uint16_t> const & bones, glm::mat4x3 const * palette, std::vector<glm::mat4x3> & result);
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/common.hpp>
+
+#include <limits>
+
+// Axis-aligned box, empty until something is added to it
+struct bounding_box
+{
+    glm::vec3 min{std::numeric_limits<float>::infinity()};
+    glm::vec3 max{-std::numeric_limits<float>::infinity()};
+
+    bool empty() const { return min.x > max.x; }
+
+    void extend(glm::vec3 const & point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void extend(bounding_box const & box)
+    {
+        min = glm::min(min, box.min);
+        max = glm::max(max, box.max);
+    }
+};
@@ -0,0 +1,387 @@
+#include "compressed_clip.hpp"
+
+#include <cmath>
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+static std::array<std::uint16_t, 3> encode_vector(glm::vec3 const & v, glm::vec3 const & min, glm::vec3 const & extent)
+{
+    std::array<std::uint16_t, 3> result;
+    for (int i = 0; i < 3; ++i)
+        result[i] = extent[i] > 0.f ? std::lround(glm::clamp((v[i] - min[i]) / extent[i], 0.f, 1.f) * 65535.f) : 0;
+    return result;
+}
+
+static glm::vec3 decode_vector(std::array<std::uint16_t, 3> const & code, glm::vec3 const & min, glm::vec3 const & extent)
+{
+    return min + extent * glm::vec3(code[0], code[1], code[2]) / 65535.f;
+}
+
+// The three smallest components of a unit quaternion lie in [-1/sqrt(2), 1/sqrt(2)],
+// they are stored in 15 bits each next to the 2-bit index of the largest one
+static float const smallest_three_range = std::sqrt(0.5f);
+
+static std::array<std::uint16_t, 3> encode_rotation(glm::quat const & q)
+{
+    float const components[4] = {q.x, q.y, q.z, q.w};
+
+    int largest = 0;
+    for (int i = 1; i < 4; ++i)
+        if (std::abs(components[i]) > std::abs(components[largest]))
+            largest = i;
+
+    // q and -q are the same rotation, the largest component is made positive and dropped
+    float const sign = components[largest] < 0.f ? -1.f : 1.f;
+
+    std::uint64_t bits = largest;
+    int shift = 2;
+    for (int i = 0; i < 4; ++i)
+    {
+        if (i == largest) continue;
+
+        float const v = glm::clamp(components[i] * sign / smallest_three_range, -1.f, 1.f);
+        bits |= std::uint64_t(std::lround((v + 1.f) * 0.5f * 32767.f)) << shift;
+        shift += 15;
+    }
+
+    return {std::uint16_t(bits), std::uint16_t(bits >> 16), std::uint16_t(bits >> 32)};
+}
+
+static glm::quat decode_rotation(std::array<std::uint16_t, 3> const & code)
+{
+    std::uint64_t const bits = std::uint64_t(code[0]) | (std::uint64_t(code[1]) << 16) | (std::uint64_t(code[2]) << 32);
+
+    int const largest = bits & 3;
+
+    float components[4];
+    float sum = 0.f;
+    int shift = 2;
+    for (int i = 0; i < 4; ++i)
+    {
+        if (i == largest) continue;
+
+        components[i] = (float((bits >> shift) & 0x7FFF) / 32767.f * 2.f - 1.f) * smallest_three_range;
+        sum += components[i] * components[i];
+        shift += 15;
+    }
+    components[largest] = std::sqrt(std::max(0.f, 1.f - sum));
+
+    return glm::quat(components[3], components[0], components[1], components[2]);
+}
+
+static glm::quat nlerp(glm::quat const & q1, glm::quat q2, float t)
+{
+    if (glm::dot(q1, q2) < 0.f)
+        q2 = -q2;
+    return glm::normalize(q1 * (1.f - t) + q2 * t);
+}
+
+static float angle(glm::quat const & q1, glm::quat const & q2)
+{
+    return 2.f * std::acos(std::min(1.f, std::abs(glm::dot(q1, q2))));
+}
+
+// The kept keys are restored as decoded, so quantization alone has to fit the bound
+template <typename T, typename Error>
+static bool within_error(std::vector<T> const & original, std::vector<T> const & decoded, Error error, float max_error)
+{
+    for (std::size_t k = 0; k < original.size(); ++k)
+        if (error(decoded[k], original[k]) > max_error)
+            return false;
+    return true;
+}
+
+// Greedily makes each segment between the kept keys as long as possible, while
+// interpolating between the decoded segment ends restores all the original keys
+// inside the segment within the error bound
+template <typename T, typename Interpolate, typename Error>
+static std::vector<std::size_t> reduce_keys(std::vector<float> const & timestamps, std::vector<T> const & original, std::vector<T> const & decoded,
+    Interpolate interpolate, Error error, float max_error)
+{
+    std::size_t const count = timestamps.size();
+
+    auto fits = [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t k = begin + 1; k < end; ++k)
+        {
+            float const t = (timestamps[k] - timestamps[begin]) / (timestamps[end] - timestamps[begin]);
+            if (error(interpolate(decoded[begin], decoded[end], t), original[k]) > max_error)
+                return false;
+        }
+        return true;
+    };
+
+    std::vector<std::size_t> result{0};
+
+    // A constant channel needs a single key
+    bool constant = true;
+    for (std::size_t k = 1; k < count && constant; ++k)
+        constant = error(decoded[0], original[k]) <= max_error;
+    if (constant)
+        return result;
+
+    for (std::size_t begin = 0; begin + 1 < count;)
+    {
+        // Double the segment while it fits, then binary search for the longest one
+        std::size_t good = begin + 1;
+        std::size_t bad = count;
+        for (std::size_t step = 1; good + step < count; step *= 2)
+        {
+            if (!fits(begin, good + step))
+            {
+                bad = good + step;
+                break;
+            }
+            good += step;
+        }
+
+        while (bad - good > 1)
+        {
+            std::size_t const middle = (good + bad) / 2;
+            if (fits(begin, middle))
+                good = middle;
+            else
+                bad = middle;
+        }
+
+        result.push_back(good);
+        begin = good;
+    }
+
+    return result;
+}
+
+// Segments of a cubic spline are cut into this many linear ones before reducing the keys
+static constexpr int cubic_subdivisions = 16;
+
+// reduce_keys() assumes linear interpolation, so the other curves are resampled
+// first: a step gets an extra key right before every change
+template <typename T>
+static gltf_model::spline<T> linearize(gltf_model::spline<T> const & spline)
+{
+    if (spline.mode == gltf_model::interpolation::linear)
+        return spline;
+
+    gltf_model::spline<T> result;
+    for (std::size_t k = 0; k < spline.timestamps.size(); ++k)
+    {
+        if (k > 0 && spline.mode == gltf_model::interpolation::step)
+        {
+            result.timestamps.push_back(std::nextafter(spline.timestamps[k], spline.timestamps[k - 1]));
+            result.values.push_back(spline.values[k - 1]);
+        }
+        else if (k > 0)
+        {
+            for (int s = 1; s < cubic_subdivisions; ++s)
+            {
+                float const time = glm::mix(spline.timestamps[k - 1], spline.timestamps[k], float(s) / cubic_subdivisions);
+                result.timestamps.push_back(time);
+                result.values.push_back(spline(time));
+            }
+        }
+
+        result.timestamps.push_back(spline.timestamps[k]);
+        result.values.push_back(spline.values[k]);
+    }
+    return result;
+}
+
+compressed_clip compress(gltf_model::animation const & animation, compression_settings const & settings)
+{
+    compressed_clip result;
+    result.bone_count = animation.bones.size();
+    result.duration = animation.max_time;
+
+    std::vector<gltf_model::bone_animation> bones;
+    for (auto const & bone : animation.bones)
+        bones.push_back({linearize(bone.translation), linearize(bone.rotation), linearize(bone.scale)});
+
+    for (auto const & bone : bones)
+        for (auto const * timestamps : {&bone.translation.timestamps, &bone.rotation.timestamps, &bone.scale.timestamps})
+            result.timeline.insert(result.timeline.end(), timestamps->begin(), timestamps->end());
+
+    std::sort(result.timeline.begin(), result.timeline.end());
+    result.timeline.erase(std::unique(result.timeline.begin(), result.timeline.end()), result.timeline.end());
+
+    // sample() also needs the index one past the last timestamp
+    if (result.timeline.size() > std::numeric_limits<std::uint16_t>::max())
+        throw std::runtime_error("Animation has " + std::to_string(result.timeline.size()) + " distinct timestamps, at most "
+            + std::to_string(std::numeric_limits<std::uint16_t>::max()) + " are supported");
+
+    auto timeline_index = [&](float time)
+    {
+        return std::uint16_t(std::lower_bound(result.timeline.begin(), result.timeline.end(), time) - result.timeline.begin());
+    };
+
+    auto lerp = [](glm::vec3 const & v1, glm::vec3 const & v2, float t) { return v1 + (v2 - v1) * t; };
+    auto distance = [](glm::vec3 const & v1, glm::vec3 const & v2) { return glm::length(v1 - v2); };
+
+    auto compress_vectors = [&](unsigned int bone, gltf_model::spline<glm::vec3> const & spline, float max_error)
+    {
+        compressed_clip::channel channel;
+        channel.bone = bone;
+
+        glm::vec3 min(std::numeric_limits<float>::infinity());
+        glm::vec3 max(-std::numeric_limits<float>::infinity());
+        for (auto const & v : spline.values)
+        {
+            min = glm::min(min, v);
+            max = glm::max(max, v);
+        }
+
+        channel.min = min;
+        channel.extent = max - min;
+
+        std::vector<std::array<std::uint16_t, 3>> codes;
+        std::vector<glm::vec3> decoded;
+        for (auto const & v : spline.values)
+        {
+            codes.push_back(encode_vector(v, channel.min, channel.extent));
+            decoded.push_back(decode_vector(codes.back(), channel.min, channel.extent));
+        }
+
+        // 16 bits over a wide range, like a long root motion, can be coarser than
+        // the bound; such channels are kept at full precision
+        bool const quantized = within_error(spline.values, decoded, distance, max_error);
+        if (!quantized)
+        {
+            decoded = spline.values;
+            channel.raw_offset = std::uint32_t(result.raw_values.size());
+        }
+
+        for (auto k : reduce_keys(spline.timestamps, spline.values, decoded, lerp, distance, max_error))
+        {
+            channel.keys.push_back(timeline_index(spline.timestamps[k]));
+            if (quantized)
+                channel.values.push_back(codes[k]);
+            else
+                result.raw_values.push_back(glm::vec4(spline.values[k], 0.f));
+        }
+
+        return channel;
+    };
+
+    auto compress_rotations = [&](unsigned int bone, gltf_model::spline<glm::quat> const & spline)
+    {
+        compressed_clip::channel channel;
+        channel.bone = bone;
+
+        std::vector<std::array<std::uint16_t, 3>> codes;
+        std::vector<glm::quat> decoded;
+        for (auto const & q : spline.values)
+        {
+            codes.push_back(encode_rotation(glm::normalize(q)));
+            decoded.push_back(decode_rotation(codes.back()));
+        }
+
+        // Only a bound tighter than the 15-bit precision gets here
+        bool const quantized = within_error(spline.values, decoded, angle, settings.rotation_error);
+        if (!quantized)
+        {
+            for (std::size_t k = 0; k < decoded.size(); ++k)
+                decoded[k] = glm::normalize(spline.values[k]);
+            channel.raw_offset = std::uint32_t(result.raw_values.size());
+        }
+
+        for (auto k : reduce_keys(spline.timestamps, spline.values, decoded, nlerp, angle, settings.rotation_error))
+        {
+            channel.keys.push_back(timeline_index(spline.timestamps[k]));
+            if (quantized)
+                channel.values.push_back(codes[k]);
+            else
+                result.raw_values.push_back(glm::vec4(decoded[k].x, decoded[k].y, decoded[k].z, decoded[k].w));
+        }
+
+        return channel;
+    };
+
+    for (unsigned int bone = 0; bone < bones.size(); ++bone)
+    {
+        auto const & bone_animation = bones[bone];
+
+        if (!bone_animation.translation.values.empty())
+            result.translations.push_back(compress_vectors(bone, bone_animation.translation, settings.translation_error));
+        if (!bone_animation.rotation.values.empty())
+            result.rotations.push_back(compress_rotations(bone, bone_animation.rotation));
+        if (!bone_animation.scale.values.empty())
+            result.scales.push_back(compress_vectors(bone, bone_animation.scale, settings.scale_error));
+    }
+
+    return result;
+}
+
+std::size_t compressed_clip::memory_size() const
+{
+    std::size_t result = sizeof(*this) + timeline.size() * sizeof(float) + raw_values.size() * sizeof(raw_values[0]);
+    for (auto const * channels : {&translations, &rotations, &scales})
+        for (auto const & channel : *channels)
+            result += sizeof(channel) + channel.keys.size() * sizeof(channel.keys[0]) + channel.values.size() * sizeof(channel.values[0]);
+    return result;
+}
+
+static glm::vec3 channel_vector(compressed_clip const & clip, compressed_clip::channel const & channel, std::size_t key)
+{
+    if (channel.raw_offset != compressed_clip::no_raw_values)
+        return glm::vec3(clip.raw_values[channel.raw_offset + key]);
+    return decode_vector(channel.values[key], channel.min, channel.extent);
+}
+
+static glm::quat channel_rotation(compressed_clip const & clip, compressed_clip::channel const & channel, std::size_t key)
+{
+    if (channel.raw_offset != compressed_clip::no_raw_values)
+    {
+        glm::vec4 const & q = clip.raw_values[channel.raw_offset + key];
+        return glm::quat(q.w, q.x, q.y, q.z);
+    }
+    return decode_rotation(channel.values[key]);
+}
+
+void sample(compressed_clip const & clip, float time, pose & result, std::vector<std::size_t> & cursors)
+{
+    assert(result.size() >= clip.bone_count);
+
+    cursors.resize(1 + clip.translations.size() + clip.rotations.size() + clip.scales.size(), 0);
+
+    // Position on the timeline, then each channel looks for the keys around it
+    std::uint16_t const frame = find_key(clip.timeline, time, cursors[0]);
+    std::size_t * cursor = cursors.data() + 1;
+
+    auto locate = [&](compressed_clip::channel const & channel, std::size_t & key0, std::size_t & key1, float & t)
+    {
+        std::size_t const key = find_key(channel.keys, frame, *cursor++);
+
+        key1 = std::min(key, channel.keys.size() - 1);
+        key0 = key == 0 ? 0 : key1 == key ? key - 1 : key1;
+
+        float const time0 = clip.timeline[channel.keys[key0]];
+        float const time1 = clip.timeline[channel.keys[key1]];
+        t = key0 == key1 ? 0.f : (time - time0) / (time1 - time0);
+    };
+
+    std::size_t key0, key1;
+    float t;
+
+    for (auto const & channel : clip.translations)
+    {
+        locate(channel, key0, key1, t);
+        glm::vec3 const v0 = channel_vector(clip, channel, key0);
+        glm::vec3 const v1 = channel_vector(clip, channel, key1);
+        result.translation[channel.bone] = v0 + (v1 - v0) * t;
+    }
+
+    for (auto const & channel : clip.rotations)
+    {
+        locate(channel, key0, key1, t);
+        result.rotation[channel.bone] = nlerp(channel_rotation(clip, channel, key0), channel_rotation(clip, channel, key1), t);
+    }
+
+    for (auto const & channel : clip.scales)
+    {
+        locate(channel, key0, key1, t);
+        glm::vec3 const v0 = channel_vector(clip, channel, key0);
+        glm::vec3 const v1 = channel_vector(clip, channel, key1);
+        result.scale[channel.bone] = v0 + (v1 - v0) * t;
+    }
+}
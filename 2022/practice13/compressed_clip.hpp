@@ -0,0 +1,67 @@
+#pragma once
+
+#include "gltf_loader.hpp"
+#include "pose.hpp"
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+// Compact storage for animations. Keys that can be restored by interpolating
+// their neighbours within the error bounds are dropped, translations and
+// scales are quantized to 16 bits per component within the range of the
+// channel, and rotations are stored as the three smallest components in 48 bits.
+// Channels for which the quantization alone exceeds the bound stay at full precision.
+// Step and cubic channels are resampled and stored as linear ones.
+struct compressed_clip
+{
+    static constexpr std::uint32_t no_raw_values = std::uint32_t(-1);
+
+    struct channel
+    {
+        unsigned int bone;
+
+        // Start of the keys in raw_values if the quantization doesn't fit the
+        // error bound and values is empty, no_raw_values otherwise
+        std::uint32_t raw_offset = no_raw_values;
+
+        // Indices into timeline, increasing
+        std::vector<std::uint16_t> keys;
+        std::vector<std::array<std::uint16_t, 3>> values;
+
+        // Range of the quantized vectors, unused for rotations
+        glm::vec3 min{0.f};
+        glm::vec3 extent{0.f};
+    };
+
+    // All the distinct timestamps of the animation
+    std::vector<float> timeline;
+
+    std::vector<channel> translations;
+    std::vector<channel> rotations;
+    std::vector<channel> scales;
+
+    // Full precision keys of all the channels with raw_offset, xyz of vectors and xyzw of rotations
+    std::vector<glm::vec4> raw_values;
+
+    std::size_t bone_count = 0;
+    float duration = 0.f;
+
+    std::size_t memory_size() const;
+};
+
+struct compression_settings
+{
+    // Maximum distance between the original and the compressed values
+    float translation_error = 1e-4f;
+    float scale_error = 1e-4f;
+    // Maximum angle in radians between the original and the compressed rotations
+    float rotation_error = 1e-3f;
+};
+
+// Throws if the animation has more than 65535 distinct timestamps
+compressed_clip compress(gltf_model::animation const & animation, compression_settings const & settings = {});
+
+// Same contract as sample() for animation_clip, with one cursor per channel plus
+// one for the timeline
+void sample(compressed_clip const & clip, float time, pose & result, std::vector<std::size_t> & cursors);
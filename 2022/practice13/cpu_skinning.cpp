@@ -0,0 +1,207 @@
+#include "cpu_skinning.hpp"
+
+#include <glm/geometric.hpp>
+#include <glm/mat3x3.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <stdexcept>
+
+// Vertices handed to a thread at once
+static constexpr std::size_t vertices_per_job = 1024;
+
+skinned_mesh read_skinned_mesh(gltf_model const & model, gltf_model::mesh const & mesh)
+{
+    if (!mesh.joints || !mesh.weights)
+        throw std::runtime_error("Mesh " + mesh.name + " is not skinned");
+
+    skinned_mesh result;
+    result.positions = read_accessor<glm::vec3>(model, mesh.position);
+    if (mesh.normal)
+        result.normals = read_accessor<glm::vec3>(model, *mesh.normal);
+
+    // Joint indices are integers, read_accessor turns them into exact floats
+    auto joints = read_accessor<glm::vec4>(model, *mesh.joints);
+    result.joints.resize(joints.size());
+    for (std::size_t i = 0; i < joints.size(); ++i)
+        for (int j = 0; j < 4; ++j)
+            result.joints[i][j] = joints[i][j];
+
+    result.weights = read_accessor<glm::vec4>(model, *mesh.weights);
+
+    return result;
+}
+
+// Rigid transform as a unit dual quaternion real + eps * dual
+struct dual_quaternion
+{
+    glm::quat real;
+    glm::quat dual;
+};
+
+static dual_quaternion to_dual_quaternion(glm::mat4x3 const & m)
+{
+    glm::quat const real = glm::normalize(glm::quat_cast(glm::mat3(m)));
+    glm::vec3 const t = m[3];
+    return {real, glm::quat(0.f, t.x, t.y, t.z) * real * 0.5f};
+}
+
+// Vertices order[begin] to order[end - 1], or begin to end - 1 without an
+// order, using the first influences of each of them
+template <int influences>
+static void skin_linear(skinned_mesh const & mesh, std::vector<glm::mat4x3> const & palette, std::uint32_t const * order, std::size_t begin, std::size_t end,
+    skinned_vertices & result, bounding_box & bounds)
+{
+    bool const has_normals = !mesh.normals.empty();
+
+    for (std::size_t k = begin; k < end; ++k)
+    {
+        std::size_t const i = order ? order[k] : k;
+
+        auto const & joints = mesh.joints[i];
+        glm::vec4 const & weights = mesh.weights[i];
+
+        glm::mat4x3 transform;
+        if constexpr (influences == 1)
+            transform = palette[joints[0]];
+        else if constexpr (influences == 2)
+        {
+            glm::mat4x3 const & m0 = palette[joints[0]];
+            glm::mat4x3 const & m1 = palette[joints[1]];
+            for (int c = 0; c < 4; ++c)
+                transform[c] = m0[c] * weights[0] + m1[c] * weights[1];
+        }
+        else
+        {
+            glm::mat4x3 const & m0 = palette[joints[0]];
+            glm::mat4x3 const & m1 = palette[joints[1]];
+            glm::mat4x3 const & m2 = palette[joints[2]];
+            glm::mat4x3 const & m3 = palette[joints[3]];
+            for (int c = 0; c < 4; ++c)
+                transform[c] = m0[c] * weights[0] + m1[c] * weights[1] + m2[c] * weights[2] + m3[c] * weights[3];
+        }
+
+        glm::vec3 const & p = mesh.positions[i];
+        result.positions[i] = transform[0] * p.x + transform[1] * p.y + transform[2] * p.z + transform[3];
+        bounds.extend(result.positions[i]);
+
+        if (has_normals)
+        {
+            // Normals go through the cofactor matrix, the inverse transpose up to
+            // the determinant, so they stay perpendicular under non-uniform scale
+            glm::vec3 const c0 = glm::cross(transform[1], transform[2]);
+            glm::vec3 const c1 = glm::cross(transform[2], transform[0]);
+            glm::vec3 const c2 = glm::cross(transform[0], transform[1]);
+            float const sign = glm::dot(transform[0], c0) < 0.f ? -1.f : 1.f;
+
+            glm::vec3 const & n = mesh.normals[i];
+            result.normals[i] = glm::normalize(c0 * n.x + c1 * n.y + c2 * n.z) * sign;
+        }
+    }
+}
+
+static void skin_dual_quaternion(skinned_mesh const & mesh, std::vector<dual_quaternion> const & bones, std::size_t begin, std::size_t end,
+    skinned_vertices & result, bounding_box & bounds)
+{
+    bool const has_normals = !mesh.normals.empty();
+
+    for (std::size_t i = begin; i < end; ++i)
+    {
+        auto const & joints = mesh.joints[i];
+        glm::vec4 const & weights = mesh.weights[i];
+
+        // All the influences are taken in the hemisphere of the first one
+        glm::quat const & pivot = bones[joints[0]].real;
+
+        glm::quat real(0.f, 0.f, 0.f, 0.f);
+        glm::quat dual(0.f, 0.f, 0.f, 0.f);
+        for (int j = 0; j < 4; ++j)
+        {
+            auto const & bone = bones[joints[j]];
+            float const weight = glm::dot(pivot, bone.real) < 0.f ? -weights[j] : weights[j];
+            real += bone.real * weight;
+            dual += bone.dual * weight;
+        }
+
+        float const inverse_length = 1.f / glm::length(real);
+        real *= inverse_length;
+        dual *= inverse_length;
+
+        glm::vec3 const r(real.x, real.y, real.z);
+        glm::vec3 const d(dual.x, dual.y, dual.z);
+        glm::vec3 const translation = 2.f * (real.w * d - dual.w * r + glm::cross(r, d));
+
+        glm::vec3 const & p = mesh.positions[i];
+        result.positions[i] = p + 2.f * glm::cross(r, glm::cross(r, p) + real.w * p) + translation;
+        bounds.extend(result.positions[i]);
+
+        if (has_normals)
+        {
+            glm::vec3 const & n = mesh.normals[i];
+            result.normals[i] = n + 2.f * glm::cross(r, glm::cross(r, n) + real.w * n);
+        }
+    }
+}
+
+void skin(skinned_mesh const & mesh, std::vector<glm::mat4x3> const & palette, skinning_mode mode, skinned_vertices & result, thread_pool & pool)
+{
+    std::size_t const count = mesh.positions.size();
+    result.positions.resize(count);
+    result.normals.resize(mesh.normals.size());
+
+    std::vector<dual_quaternion> bones;
+    if (mode == skinning_mode::dual_quaternion)
+    {
+        bones.reserve(palette.size());
+        for (auto const & transform : palette)
+            bones.push_back(to_dual_quaternion(transform));
+    }
+
+    // Each batch has its own bounds, merged in order afterwards
+    std::vector<bounding_box> batch_bounds;
+
+    auto skin_vertices = [&](std::size_t vertex_count, auto skin_batch)
+    {
+        std::size_t const first_batch = batch_bounds.size();
+        batch_bounds.resize(first_batch + (vertex_count + vertices_per_job - 1) / vertices_per_job);
+
+        pool.parallel_for(vertex_count, vertices_per_job, [&](std::size_t begin, std::size_t end)
+        {
+            skin_batch(begin, end, batch_bounds[first_batch + begin / vertices_per_job]);
+        });
+    };
+
+    if (mode == skinning_mode::dual_quaternion)
+        skin_vertices(count, [&](std::size_t begin, std::size_t end, bounding_box & bounds)
+        {
+            skin_dual_quaternion(mesh, bones, begin, end, result, bounds);
+        });
+    else if (mesh.vertex_order.empty())
+        skin_vertices(count, [&](std::size_t begin, std::size_t end, bounding_box & bounds)
+        {
+            skin_linear<4>(mesh, palette, nullptr, begin, end, result, bounds);
+        });
+    else
+    {
+        std::uint32_t const * order = mesh.vertex_order.data();
+        std::size_t const one = mesh.influence_groups[0];
+        std::size_t const two = mesh.influence_groups[1];
+        std::size_t const four = mesh.influence_groups[2];
+
+        skin_vertices(one, [&](std::size_t begin, std::size_t end, bounding_box & bounds)
+        {
+            skin_linear<1>(mesh, palette, order, begin, end, result, bounds);
+        });
+        skin_vertices(two - one, [&](std::size_t begin, std::size_t end, bounding_box & bounds)
+        {
+            skin_linear<2>(mesh, palette, order + one, begin, end, result, bounds);
+        });
+        skin_vertices(four - two, [&](std::size_t begin, std::size_t end, bounding_box & bounds)
+        {
+            skin_linear<4>(mesh, palette, order + two, begin, end, result, bounds);
+        });
+    }
+
+    result.bounds = {};
+    for (auto const & bounds : batch_bounds)
+        result.bounds.extend(bounds);
+}
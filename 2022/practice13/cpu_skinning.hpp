@@ -0,0 +1,58 @@
+#pragma once
+
+#include "gltf_loader.hpp"
+#include "bounding_box.hpp"
+#include "thread_pool.hpp"
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x3.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Bind pose vertices of a skinned mesh with up to four influences each. Meshes
+// with fewer influences per vertex (like the two of human.bin) just leave the
+// remaining weights at zero.
+struct skinned_mesh
+{
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<std::array<std::uint16_t, 4>> joints;
+    std::vector<glm::vec4> weights;
+
+    // Optional, see process_skin_weights(): all the vertices ordered so that
+    // the ones with a single influence go first, then the ones with two, then
+    // the rest, influence_groups[n] being where the run of n + 1 influences ends.
+    // Influences are sorted by weight, so the vertices of the first two runs
+    // are skinned with only the first one or two of them.
+    std::vector<std::uint32_t> vertex_order;
+    std::array<std::size_t, 3> influence_groups{0, 0, 0};
+};
+
+skinned_mesh read_skinned_mesh(gltf_model const & model, gltf_model::mesh const & mesh);
+
+enum class skinning_mode
+{
+    // Weighted sum of the bone matrices, collapses around twisting joints
+    linear,
+    // Weighted sum of the bones as dual quaternions, keeps the volume but
+    // ignores any scale in the palette
+    dual_quaternion,
+};
+
+struct skinned_vertices
+{
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+
+    // Bounds of the skinned positions
+    bounding_box bounds;
+};
+
+// Skins all the vertices with the palette (see evaluate() in skeleton.hpp),
+// spread over the pool in batches. Linear blending uses the influence groups
+// of the mesh when it has them. The result doesn't depend on the number
+// of threads.
+void skin(skinned_mesh const & mesh, std::vector<glm::mat4x3> const & palette, skinning_mode mode, skinned_vertices & result, thread_pool & pool);
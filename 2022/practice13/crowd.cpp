@@ -0,0 +1,255 @@
+#include "crowd.hpp"
+
+#include <glm/mat4x4.hpp>
+#include <glm/matrix.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// Number of instances handed to a thread at once
+static constexpr std::size_t instances_per_job = 16;
+
+// Per-thread scratch buffers, reused between frames
+struct crowd_scratch
+{
+    pose sampled;
+    pose blended;
+    std::vector<glm::mat4x3> world;
+    std::vector<glm::mat4x3> palette;
+};
+
+static float wrap(float time, float duration)
+{
+    if (duration <= 0.f)
+        return 0.f;
+
+    time = std::fmod(time, duration);
+    return time < 0.f ? time + duration : time;
+}
+
+std::vector<std::vector<animation_clip>> make_crowd_clips(skeleton const & skeleton, std::vector<gltf_model::animation const *> const & animations, std::vector<float> const & max_errors)
+{
+    std::size_t const bone_count = skeleton.size();
+
+    // Points checked for displacement: the origin of every bone and, for the
+    // leaves, a tip as far from the bone as the bone is from its parent. Each
+    // one follows the palette entry of the bone it belongs to
+    std::vector<glm::vec3> bind_positions(bone_count);
+    for (std::size_t i = 0; i < bone_count; ++i)
+        bind_positions[i] = glm::inverse(glm::mat4(skeleton.inverse_bind_matrices[i]))[3];
+
+    std::vector<bool> leaf(bone_count, true);
+    for (std::size_t i = 0; i < bone_count; ++i)
+        if (skeleton.parents[i] != skeleton::no_parent)
+            leaf[skeleton.parents[i]] = false;
+
+    std::vector<std::pair<unsigned int, glm::vec4>> points;
+    for (unsigned int i = 0; i < bone_count; ++i)
+    {
+        points.emplace_back(i, glm::vec4(bind_positions[i], 1.f));
+        if (leaf[i] && skeleton.parents[i] != skeleton::no_parent)
+            points.emplace_back(i, glm::vec4(2.f * bind_positions[i] - bind_positions[skeleton.parents[i]], 1.f));
+    }
+
+    // Poses of every animation at all of its keys together with the reference palettes
+    std::vector<pose> poses;
+    std::vector<std::vector<glm::mat4x3>> references;
+    std::vector<glm::mat4x3> world, palette;
+    for (auto const * animation : animations)
+    {
+        auto const clip = make_clip(*animation);
+        std::vector<std::size_t> cursors;
+        for (auto const & track : clip.tracks)
+            for (float time : track.timestamps)
+            {
+                pose & sampled = poses.emplace_back(skeleton.rest_pose);
+                sample(clip, time, sampled, cursors);
+                evaluate(skeleton, sampled, world, palette);
+                references.push_back(palette);
+            }
+    }
+
+    // Largest displacement of the points when the bones not in animated stay in the rest pose
+    pose reduced;
+    auto measure = [&](std::vector<bool> const & animated)
+    {
+        float result = 0.f;
+        for (std::size_t p = 0; p < poses.size(); ++p)
+        {
+            reduced = poses[p];
+            for (std::size_t i = 0; i < bone_count; ++i)
+                if (!animated[i])
+                {
+                    reduced.translation[i] = skeleton.rest_pose.translation[i];
+                    reduced.rotation[i] = skeleton.rest_pose.rotation[i];
+                    reduced.scale[i] = skeleton.rest_pose.scale[i];
+                }
+
+            evaluate(skeleton, reduced, world, palette);
+            for (auto const & [bone, point] : points)
+                result = std::max(result, glm::distance(palette[bone] * point, references[p][bone] * point));
+        }
+        return result;
+    };
+
+    // Bones are tried from the least to the most important one
+    std::vector<float> importance(bone_count, 0.f);
+    std::vector<bool> animated(bone_count, true);
+    for (std::size_t i = 0; i < bone_count; ++i)
+    {
+        animated[i] = false;
+        importance[i] = measure(animated);
+        animated[i] = true;
+    }
+
+    std::vector<unsigned int> order(bone_count);
+    for (unsigned int i = 0; i < bone_count; ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int i, unsigned int j){ return importance[i] < importance[j]; });
+
+    std::vector<std::vector<animation_clip>> result(animations.size());
+    for (std::size_t level = 0; level <= max_errors.size(); ++level)
+    {
+        // Each level starts from the bones dropped by the previous one
+        if (level > 0)
+            for (unsigned int i : order)
+            {
+                if (!animated[i] || skeleton.parents[i] == skeleton::no_parent || importance[i] > max_errors[level - 1])
+                    continue;
+
+                animated[i] = false;
+                if (measure(animated) > max_errors[level - 1])
+                    animated[i] = true;
+            }
+
+        for (std::size_t clip = 0; clip < animations.size(); ++clip)
+            result[clip].push_back(make_clip(*animations[clip], animated));
+    }
+
+    return result;
+}
+
+crowd::lod select_lod(float screen_size)
+{
+    if (screen_size >= 0.25f)
+        return {1, 0};
+    if (screen_size >= 0.1f)
+        return {2, 0};
+    if (screen_size >= 0.05f)
+        return {2, 1};
+    return {4, 2};
+}
+
+// Blends the layers of the instance sampled ahead seconds into the future
+static void blend_layers(crowd const & crowd, crowd::instance & instance, float ahead, crowd_scratch & scratch)
+{
+    auto const & skeleton = *crowd.rig;
+    std::size_t const bone_count = skeleton.size();
+
+    auto sample_layer = [&](crowd::layer & layer, pose & result)
+    {
+        auto const & levels = (*crowd.clips)[layer.clip];
+        auto const & clip = levels[std::min<std::size_t>(instance.lod.bone_level, levels.size() - 1)];
+        sample(clip, wrap(layer.time + ahead * layer.speed, clip.duration), result, layer.cursors);
+    };
+
+    if (instance.layers.size() <= 1)
+    {
+        scratch.blended = skeleton.rest_pose;
+        if (!instance.layers.empty())
+            sample_layer(instance.layers[0], scratch.blended);
+        return;
+    }
+
+    scratch.blended.resize(bone_count);
+    std::fill(scratch.blended.translation.begin(), scratch.blended.translation.end(), glm::vec3(0.f));
+    std::fill(scratch.blended.rotation.begin(), scratch.blended.rotation.end(), glm::quat(0.f, 0.f, 0.f, 0.f));
+    std::fill(scratch.blended.scale.begin(), scratch.blended.scale.end(), glm::vec3(0.f));
+
+    float total_weight = 0.f;
+    for (auto & layer : instance.layers)
+    {
+        scratch.sampled = skeleton.rest_pose;
+        sample_layer(layer, scratch.sampled);
+
+        float const weight = layer.weight;
+        total_weight += weight;
+
+        for (std::size_t bone = 0; bone < bone_count; ++bone)
+        {
+            scratch.blended.translation[bone] += scratch.sampled.translation[bone] * weight;
+            scratch.blended.scale[bone] += scratch.sampled.scale[bone] * weight;
+
+            // Rotations are summed in the hemisphere of what has been accumulated so far
+            glm::quat const & rotation = scratch.sampled.rotation[bone];
+            float const sign = glm::dot(scratch.blended.rotation[bone], rotation) < 0.f ? -1.f : 1.f;
+            scratch.blended.rotation[bone] += rotation * (weight * sign);
+        }
+    }
+
+    if (total_weight <= 0.f)
+    {
+        scratch.blended = skeleton.rest_pose;
+        return;
+    }
+
+    for (std::size_t bone = 0; bone < bone_count; ++bone)
+    {
+        scratch.blended.translation[bone] /= total_weight;
+        scratch.blended.scale[bone] /= total_weight;
+        scratch.blended.rotation[bone] = glm::normalize(scratch.blended.rotation[bone]);
+    }
+}
+
+void update(crowd & crowd, float dt, thread_pool & pool)
+{
+    std::size_t const bone_count = crowd.rig->size();
+    crowd.palettes.resize(crowd.instances.size() * bone_count);
+    crowd.interval_palettes.resize(crowd.palettes.size() * 2);
+
+    pool.parallel_for(crowd.instances.size(), instances_per_job, [&](std::size_t begin, std::size_t end)
+    {
+        thread_local crowd_scratch scratch;
+
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            auto & instance = crowd.instances[i];
+
+            for (auto & layer : instance.layers)
+                layer.time = wrap(layer.time + dt * layer.speed, (*crowd.clips)[layer.clip][0].duration);
+
+            glm::mat4x3 * palette = crowd.palettes.data() + i * bone_count;
+            glm::mat4x3 * from = crowd.interval_palettes.data() + 2 * i * bone_count;
+            glm::mat4x3 * to = from + bone_count;
+
+            if (instance.interval_left == 0)
+            {
+                unsigned int const interval = std::max(instance.lod.interval, 1u);
+                bool const first = instance.interval_length == 0;
+
+                instance.interval_length = first ? 1 + i % interval : interval;
+                instance.interval_left = instance.interval_length;
+
+                blend_layers(crowd, instance, dt * (instance.interval_length - 1), scratch);
+                evaluate(*crowd.rig, scratch.blended, scratch.world, scratch.palette);
+
+                if (instance.interval_length > 1)
+                {
+                    glm::mat4x3 const * shown = first ? scratch.palette.data() : palette;
+                    std::copy(shown, shown + bone_count, from);
+                    std::copy(scratch.palette.begin(), scratch.palette.end(), to);
+                }
+                else
+                    std::copy(scratch.palette.begin(), scratch.palette.end(), palette);
+            }
+
+            unsigned int const step = instance.interval_length - --instance.interval_left;
+            if (instance.interval_length > 1)
+            {
+                float const t = float(step) / instance.interval_length;
+                for (std::size_t bone = 0; bone < bone_count; ++bone)
+                    palette[bone] = from[bone] + (to[bone] - from[bone]) * t;
+            }
+        }
+    });
+}
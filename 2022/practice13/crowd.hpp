@@ -0,0 +1,89 @@
+#pragma once
+
+#include "animation_clip.hpp"
+#include "skeleton.hpp"
+#include "thread_pool.hpp"
+
+#include <glm/mat4x3.hpp>
+
+#include <memory>
+#include <vector>
+
+// Many animated copies of one skeleton. The skeleton and the clips are
+// immutable and shared by all the instances, each instance only keeps its
+// own playback state.
+struct crowd
+{
+    struct layer
+    {
+        unsigned int clip = 0;
+        float time = 0.f;
+        float speed = 1.f;
+        float weight = 1.f;
+
+        // Key search state for sample(), doesn't affect the result
+        std::vector<std::size_t> cursors;
+    };
+
+    // Level of detail of an instance: the pose is evaluated every interval
+    // frames and interpolated in between, and sampled from the clips at
+    // bone_level (see make_crowd_clips)
+    struct lod
+    {
+        unsigned int interval = 1;
+        unsigned int bone_level = 0;
+    };
+
+    struct instance
+    {
+        // Blended by their weights, an instance without layers stays in the rest pose
+        std::vector<layer> layers;
+
+        crowd::lod lod;
+
+        // Length of the current update interval and frames left in it, 0 before the first update
+        unsigned int interval_length = 0;
+        unsigned int interval_left = 0;
+    };
+
+    std::shared_ptr<skeleton const> rig;
+
+    // clips[clip][bone_level]
+    std::shared_ptr<std::vector<std::vector<animation_clip>> const> clips;
+
+    std::vector<instance> instances;
+
+    // Skinning palettes of all the instances one after another,
+    // palettes[instance * rig->size() + bone]
+    std::vector<glm::mat4x3> palettes;
+
+    // Palettes at both ends of the current update interval of each instance,
+    // only used by the instances updated less often than every frame
+    std::vector<glm::mat4x3> interval_palettes;
+
+    glm::mat4x3 const * palette(std::size_t instance) const { return palettes.data() + instance * rig->size(); }
+};
+
+// Each animation at several levels of detail. Level 0 animates all the bones,
+// level k also leaves in the rest pose the bones that can be dropped while no
+// joint (nor the tip of a leaf bone) moves by more than max_errors[k - 1] in
+// mesh space at any key of any of the animations. Bones are dropped greedily
+// from the least important one, the root always stays animated.
+std::vector<std::vector<animation_clip>> make_crowd_clips(skeleton const & skeleton, std::vector<gltf_model::animation const *> const & animations, std::vector<float> const & max_errors);
+
+// Level of detail for an instance whose bounding sphere covers screen_size of
+// the viewport height: full detail up close, then half and quarter update
+// rates, then fewer bones as well
+crowd::lod select_lod(float screen_size);
+
+// Advances the time of every layer by dt times its speed, looping the clips,
+// and recomputes the palettes. Instances are spread over the pool, each one is
+// evaluated independently of the others, so the result is the same for any
+// number of threads.
+//
+// An instance with an update interval of N evaluates its pose once per N
+// frames, predicting it at the end of the interval assuming dt stays the same,
+// and the palettes of the frames in between are interpolated from the one
+// shown before. Instances start their intervals on different frames to spread
+// the work evenly.
+void update(crowd & crowd, float dt, thread_pool & pool);
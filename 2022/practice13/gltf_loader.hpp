@@ -1,11 +1,13 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
 #include <vector>
 #include <string>
 #include <optional>
 #include <unordered_map>
 #include <algorithm>
+#include <cassert>
 
 #define GLM_FORCE_SWIZZLE
 #define GLM_ENABLE_EXPERIMENTAL
@@ -18,8 +20,13 @@ struct gltf_model
 {
     struct buffer_view
     {
-        unsigned int offset;
-        unsigned int size;
+        // Index into buffers
+        unsigned int buffer = 0;
+        // Offset of the first element, the accessor offset included
+        unsigned int offset = 0;
+        unsigned int size = 0;
+        // Zero means tightly packed, like in OpenGL
+        unsigned int stride = 0;
     };
 
     struct accessor
@@ -28,6 +35,7 @@ struct gltf_model
         unsigned int type;
         unsigned int size;
         unsigned int count;
+        bool normalized = false;
     };
 
     struct material
@@ -43,6 +51,17 @@ struct gltf_model
         unsigned int parent = -1;
         std::string name;
         glm::mat4 inverse_bind_matrix;
+        // Index into nodes
+        unsigned int node = -1;
+    };
+
+    enum class interpolation
+    {
+        linear,
+        // The value of the previous key until the next one
+        step,
+        // Hermite curve through the values, with a tangent on each side of every key
+        cubic_spline,
     };
 
     template <typename T>
@@ -51,7 +70,25 @@ struct gltf_model
         std::vector<float> timestamps;
         std::vector<T> values;
 
+        interpolation mode = interpolation::linear;
+
+        // Only for cubic_spline: derivatives per second when arriving at and
+        // leaving every key
+        std::vector<T> in_tangents;
+        std::vector<T> out_tangents;
+
+        // Clamped to the first and the last keys outside of the timestamps
         T operator()(float time) const;
+
+        // Same as above, but the search starts from the key found by the previous
+        // call with the same cursor: playing forward by small steps costs O(1)
+        // per sample, seeks and loops fall back to the binary search
+        T operator()(float time, std::size_t & cursor) const;
+
+        // Index of the first key not earlier than time, like std::lower_bound
+        std::size_t find_key(float time, std::size_t & cursor) const;
+
+        T interpolate(std::size_t key, float time) const;
     };
 
     struct bone_animation
@@ -67,58 +104,191 @@ struct gltf_model
         float max_time = 0.f;
     };
 
+    struct skin
+    {
+        std::string name;
+        std::vector<bone> bones;
+        std::unordered_map<std::string, animation> animations;
+    };
+
+    // One primitive of a glTF mesh
     struct mesh
     {
         std::string name;
         struct material material;
 
-        accessor indices;
+        // GL_TRIANGLES, GL_LINES etc, the values match
+        unsigned int mode = 4;
+
+        // Non-indexed if missing
+        std::optional<accessor> indices;
 
         accessor position;
-        accessor normal;
-        accessor texcoord;
-        accessor joints;
-        accessor weights;
+        std::optional<accessor> normal;
+        std::optional<accessor> texcoord;
+        std::optional<accessor> joints;
+        std::optional<accessor> weights;
+
+        // Index into skins, -1 if the mesh isn't skinned
+        unsigned int skin = -1;
+
+        // Nodes that draw this mesh
+        std::vector<unsigned int> instances;
+    };
+
+    struct node
+    {
+        std::string name;
+        unsigned int parent = -1;
     };
 
-    std::vector<char> buffer;
+    // Binary data of a buffer: either a copy of the file in memory or a
+    // range of the mapped file, kept alive by the owner
+    struct buffer_data
+    {
+        std::shared_ptr<void const> owner;
+        char const * pointer = nullptr;
+        std::size_t length = 0;
+
+        char const * data() const { return pointer; }
+        std::size_t size() const { return length; }
+    };
+
+    // The glTF buffers as they are in the files, followed by
+    // a buffer with the sparse accessors expanded if there are any
+    std::vector<buffer_data> buffers;
     std::vector<mesh> meshes;
-    std::vector<bone> bones;
-    std::unordered_map<std::string, animation> animations;
+    std::vector<skin> skins;
+
+    // The node tree flattened so that parents go before children and each
+    // subtree is contiguous; the transforms are stored in separate arrays
+    std::vector<node> nodes;
+    std::vector<glm::mat4> local_transforms;
+    std::vector<glm::mat4> world_transforms;
 };
 
-gltf_model load_gltf(std::filesystem::path const & path);
+enum class gltf_buffer_mode
+{
+    // Read the files into memory
+    read,
+    // Map the files into memory, so that the pages are only loaded on access
+    map,
+};
+
+// Loads both .gltf with external buffers and binary .glb files
+gltf_model load_gltf(std::filesystem::path const & path, gltf_buffer_mode mode = gltf_buffer_mode::map);
+
+// Recomputes the world transforms from the local ones in a single pass
+void update_world_transforms(gltf_model & model);
 
-template <>
-inline glm::vec3 gltf_model::spline<glm::vec3>::operator()(float time) const
+// Converts the elements of an accessor to floats, taking care of the stride and
+// the normalized integer types; the output should hold count * size floats
+void read_accessor(gltf_model const & model, gltf_model::accessor const & accessor, float * output);
+
+template <typename T>
+std::vector<T> read_accessor(gltf_model const & model, gltf_model::accessor const & accessor)
 {
-    assert(!values.empty());
+    assert(sizeof(T) == accessor.size * sizeof(float));
 
-    auto it = std::lower_bound(timestamps.begin(), timestamps.end(), time);
-    if (it == timestamps.begin())
-        return values.back();
-    if (it == timestamps.end())
-        return values.back();
+    std::vector<T> result(accessor.count);
+    read_accessor(model, accessor, reinterpret_cast<float *>(result.data()));
+    return result;
+}
 
-    int i = it - timestamps.begin();
+inline glm::vec3 spline_mix(glm::vec3 const & v1, glm::vec3 const & v2, float t)
+{
+    return glm::lerp(v1, v2, t);
+}
 
-    float t = (time - timestamps[i - 1]) / (timestamps[i] - timestamps[i - 1]);
-    return glm::lerp(values[i - 1], values[i], t);
+inline glm::quat spline_mix(glm::quat const & q1, glm::quat const & q2, float t)
+{
+    return glm::slerp(q1, q2, t);
 }
 
-template <>
-inline glm::quat gltf_model::spline<glm::quat>::operator()(float time) const
+// Weights of the start value, the start tangent, the end value and the end
+// tangent of a cubic Hermite segment at t in [0, 1], tangents scaled to the
+// segment duration
+inline glm::vec4 hermite_basis(float t)
+{
+    float const t2 = t * t;
+    float const t3 = t2 * t;
+    return {2.f * t3 - 3.f * t2 + 1.f, t3 - 2.f * t2 + t, 3.f * t2 - 2.f * t3, t3 - t2};
+}
+
+inline glm::vec3 spline_hermite(glm::vec3 const & v1, glm::vec3 const & out1, glm::vec3 const & v2, glm::vec3 const & in2, glm::vec4 const & basis)
+{
+    return v1 * basis[0] + out1 * basis[1] + v2 * basis[2] + in2 * basis[3];
+}
+
+// The glTF spec interpolates the quaternion components and normalizes the result
+inline glm::quat spline_hermite(glm::quat const & q1, glm::quat const & out1, glm::quat const & q2, glm::quat const & in2, glm::vec4 const & basis)
+{
+    return glm::normalize(q1 * basis[0] + out1 * basis[1] + q2 * basis[2] + in2 * basis[3]);
+}
+
+template <typename T>
+T gltf_model::spline<T>::operator()(float time) const
 {
     assert(!values.empty());
 
     auto it = std::lower_bound(timestamps.begin(), timestamps.end(), time);
-    if (it == timestamps.begin())
-        return values.back();
-    if (it == timestamps.end())
+    return interpolate(it - timestamps.begin(), time);
+}
+
+template <typename T>
+T gltf_model::spline<T>::operator()(float time, std::size_t & cursor) const
+{
+    assert(!values.empty());
+
+    return interpolate(find_key(time, cursor), time);
+}
+
+// Index of the first timestamp not earlier than time, like std::lower_bound,
+// starting the search from the result of the previous call
+template <typename T>
+std::size_t find_key(std::vector<T> const & timestamps, T time, std::size_t & cursor)
+{
+    std::size_t const size = timestamps.size();
+
+    // All the keys before the cursor are earlier than time, so look at the next few keys
+    if (cursor <= size && (cursor == 0 || timestamps[cursor - 1] < time))
+    {
+        for (int step = 0; step < 4 && cursor < size; ++step, ++cursor)
+            if (time <= timestamps[cursor])
+                return cursor;
+
+        if (cursor == size)
+            return cursor;
+    }
+
+    cursor = std::lower_bound(timestamps.begin(), timestamps.end(), time) - timestamps.begin();
+    return cursor;
+}
+
+template <typename T>
+std::size_t gltf_model::spline<T>::find_key(float time, std::size_t & cursor) const
+{
+    return ::find_key(timestamps, time, cursor);
+}
+
+template <typename T>
+T gltf_model::spline<T>::interpolate(std::size_t i, float time) const
+{
+    if (i == 0)
+        return values.front();
+    if (i == timestamps.size())
         return values.back();
 
-    int i = it - timestamps.begin();
+    float const duration = timestamps[i] - timestamps[i - 1];
+    float const t = (time - timestamps[i - 1]) / duration;
 
-    float t = (time - timestamps[i - 1]) / (timestamps[i] - timestamps[i - 1]);
-    return glm::slerp(values[i - 1], values[i], t);
+    switch (mode)
+    {
+    case interpolation::step:
+        return time < timestamps[i] ? values[i - 1] : values[i];
+    case interpolation::cubic_spline:
+        return spline_hermite(values[i - 1], out_tangents[i - 1] * duration, values[i], in_tangents[i] * duration, hermite_basis(t));
+    default:
+        return spline_mix(values[i - 1], values[i], t);
+    }
 }
@@ -0,0 +1,315 @@
+#include "ik.hpp"
+
+#include <glm/geometric.hpp>
+#include <glm/mat3x3.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cassert>
+#include <cmath>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+// Poses handed to a thread at once
+static constexpr std::size_t poses_per_job = 16;
+
+// Longest chain a FABRIK target can have
+static constexpr unsigned int max_chain_length = 16;
+
+// Number of bones the solver rotates above target.bone
+static unsigned int chain_length(ik_target const & target)
+{
+    return target.solver == ik_solver::two_bone ? 2 : target.chain_length;
+}
+
+// The solvers walk the chain without checks, so every target is checked up
+// front, before any pose changes
+static void validate(skeleton const & skeleton, ik_target const & target)
+{
+    if (target.bone >= skeleton.size())
+        throw std::runtime_error("IK target bone " + std::to_string(target.bone) + " is out of range");
+
+    unsigned int const length = chain_length(target);
+    if (length == 0 || length > max_chain_length)
+        throw std::runtime_error("IK chain length " + std::to_string(length) + " is out of range, 1 to "
+            + std::to_string(max_chain_length) + " are supported");
+
+    unsigned int bone = target.bone;
+    for (unsigned int k = 0; k < length; ++k)
+    {
+        bone = skeleton.parents[bone];
+        if (bone == skeleton::no_parent)
+            throw std::runtime_error("IK target bone " + std::to_string(target.bone) + " has fewer than "
+                + std::to_string(length) + " ancestors");
+    }
+}
+
+static glm::quat world_rotation(glm::mat4x3 const & m)
+{
+    return glm::normalize(glm::quat_cast(glm::mat3(glm::normalize(m[0]), glm::normalize(m[1]), glm::normalize(m[2]))));
+}
+
+// Smallest rotation taking direction from to direction to
+static glm::quat rotation_between(glm::vec3 const & from, glm::vec3 const & to)
+{
+    glm::vec3 const a = glm::normalize(from);
+    glm::vec3 const b = glm::normalize(to);
+    float const cos_angle = glm::dot(a, b);
+
+    if (cos_angle < -0.9999f)
+    {
+        // Opposite directions, any axis perpendicular to them works
+        glm::vec3 axis = glm::cross(glm::vec3(1.f, 0.f, 0.f), a);
+        if (glm::dot(axis, axis) < 1e-6f)
+            axis = glm::cross(glm::vec3(0.f, 1.f, 0.f), a);
+        return glm::angleAxis(glm::pi<float>(), glm::normalize(axis));
+    }
+
+    glm::vec3 const axis = glm::cross(a, b);
+    return glm::normalize(glm::quat(1.f + cos_angle, axis.x, axis.y, axis.z));
+}
+
+static void update_world(skeleton const & skeleton, pose const & pose, unsigned int bone, std::vector<glm::mat4x3> & world)
+{
+    glm::mat3 const rotation = glm::mat3_cast(pose.rotation[bone]);
+    glm::vec3 const & scale = pose.scale[bone];
+    glm::mat4x3 const transform(rotation[0] * scale.x, rotation[1] * scale.y, rotation[2] * scale.z, pose.translation[bone]);
+
+    unsigned int const parent = skeleton.parents[bone];
+    world[bone] = compose(parent == skeleton::no_parent ? skeleton.root_transform : world[parent], transform);
+}
+
+// The same for bone and all its descendants; parents go before children, so
+// they are found in one pass over the bones after it
+static void update_subtree(skeleton const & skeleton, pose const & pose, unsigned int bone, std::vector<glm::mat4x3> & world)
+{
+    thread_local std::vector<char> moved;
+    moved.assign(skeleton.size(), 0);
+
+    update_world(skeleton, pose, bone, world);
+    moved[bone] = 1;
+
+    for (unsigned int i = bone + 1; i < skeleton.size(); ++i)
+    {
+        unsigned int const parent = skeleton.parents[i];
+        if (parent != skeleton::no_parent && moved[parent])
+        {
+            update_world(skeleton, pose, i, world);
+            moved[i] = 1;
+        }
+    }
+}
+
+// Applies the world space rotation delta to the bone around its origin; the
+// world transforms of the bone and its descendants have to be updated after
+static void rotate_bone(pose & pose, unsigned int bone, glm::quat const & delta, std::vector<glm::mat4x3> const & world)
+{
+    glm::quat const current = world_rotation(world[bone]);
+    pose.rotation[bone] = glm::normalize(pose.rotation[bone] * (glm::inverse(current) * delta * current));
+}
+
+static glm::vec3 origin(std::vector<glm::mat4x3> const & world, unsigned int bone)
+{
+    return world[bone][3];
+}
+
+static void solve_two_bone(skeleton const & skeleton, pose & pose, ik_target const & target, std::vector<glm::mat4x3> & world)
+{
+    unsigned int const end = target.bone;
+    unsigned int const middle = skeleton.parents[end];
+    unsigned int const root = skeleton.parents[middle];
+
+    glm::vec3 const a = origin(world, root);
+    glm::vec3 const b = origin(world, middle);
+    glm::vec3 const c = origin(world, end);
+    glm::vec3 const t = target.position;
+
+    float const upper = glm::distance(a, b);
+    float const lower = glm::distance(b, c);
+    float const eps = 1e-5f * (upper + lower);
+    float const reach = glm::clamp(glm::distance(a, t), std::abs(upper - lower) + eps, upper + lower - eps);
+
+    auto angle = [](glm::vec3 const & u, glm::vec3 const & v)
+    {
+        return std::acos(glm::clamp(glm::dot(glm::normalize(u), glm::normalize(v)), -1.f, 1.f));
+    };
+
+    // Interior angles of the triangle root, middle, end now and once the end reaches the target
+    float const root_angle = angle(c - a, b - a);
+    float const middle_angle = angle(a - b, c - b);
+    float const root_target_angle = std::acos(glm::clamp((lower * lower - upper * upper - reach * reach) / (-2.f * upper * reach), -1.f, 1.f));
+    float const middle_target_angle = std::acos(glm::clamp((reach * reach - upper * upper - lower * lower) / (-2.f * upper * lower), -1.f, 1.f));
+
+    // Bend in the current plane of the chain; a straight chain bends towards the pole, or any way
+    glm::vec3 bend_axis = glm::cross(c - a, b - a);
+    if (glm::dot(bend_axis, bend_axis) < 1e-12f)
+    {
+        glm::vec3 const hint = target.pole ? *target.pole - a : glm::vec3(0.f, 0.f, 1.f);
+        bend_axis = glm::cross(c - a, hint);
+        if (glm::dot(bend_axis, bend_axis) < 1e-12f)
+            bend_axis = glm::cross(c - a, glm::vec3(1.f, 0.f, 0.f));
+    }
+    bend_axis = glm::normalize(bend_axis);
+
+    rotate_bone(pose, root, glm::angleAxis(root_target_angle - root_angle, bend_axis), world);
+    update_world(skeleton, pose, root, world);
+    update_world(skeleton, pose, middle, world);
+
+    rotate_bone(pose, middle, glm::angleAxis(middle_target_angle - middle_angle, bend_axis), world);
+    update_world(skeleton, pose, middle, world);
+    update_world(skeleton, pose, end, world);
+
+    // Swing the whole chain onto the target
+    rotate_bone(pose, root, rotation_between(origin(world, end) - a, t - a), world);
+    update_world(skeleton, pose, root, world);
+    update_world(skeleton, pose, middle, world);
+    update_world(skeleton, pose, end, world);
+
+    // Twist around the root to target axis until the middle joint faces the pole
+    if (target.pole)
+    {
+        glm::vec3 const axis = glm::normalize(t - a);
+        glm::vec3 const middle_offset = origin(world, middle) - a;
+        glm::vec3 const pole_offset = *target.pole - a;
+        glm::vec3 const from = middle_offset - axis * glm::dot(middle_offset, axis);
+        glm::vec3 const to = pole_offset - axis * glm::dot(pole_offset, axis);
+
+        if (glm::dot(from, from) > 1e-12f && glm::dot(to, to) > 1e-12f)
+        {
+            rotate_bone(pose, root, rotation_between(from, to), world);
+            update_world(skeleton, pose, root, world);
+            update_world(skeleton, pose, middle, world);
+            update_world(skeleton, pose, end, world);
+        }
+    }
+}
+
+static void solve_fabrik(skeleton const & skeleton, pose & pose, ik_target const & target, ik_settings const & settings, std::vector<glm::mat4x3> & world)
+{
+    unsigned int const length = target.chain_length;
+
+    // chain[0] is the topmost rotated bone, chain[length] the end
+    unsigned int chain[max_chain_length + 1];
+    chain[length] = target.bone;
+    for (unsigned int k = length; k > 0; --k)
+        chain[k - 1] = skeleton.parents[chain[k]];
+
+    glm::vec3 positions[max_chain_length + 1];
+    float lengths[max_chain_length];
+    float total_length = 0.f;
+    for (unsigned int k = 0; k <= length; ++k)
+        positions[k] = origin(world, chain[k]);
+    for (unsigned int k = 0; k < length; ++k)
+    {
+        lengths[k] = glm::distance(positions[k], positions[k + 1]);
+        total_length += lengths[k];
+    }
+
+    glm::vec3 const base = positions[0];
+    glm::vec3 const goal = target.position;
+
+    if (glm::distance(base, goal) >= total_length)
+    {
+        // Out of reach, straighten the chain towards the target
+        glm::vec3 const direction = glm::normalize(goal - base);
+        for (unsigned int k = 0; k < length; ++k)
+            positions[k + 1] = positions[k] + direction * lengths[k];
+    }
+    else
+    {
+        for (unsigned int iteration = 0; iteration < settings.max_iterations; ++iteration)
+        {
+            if (glm::distance(positions[length], goal) <= settings.tolerance)
+                break;
+
+            // Backward: pin the end to the target
+            positions[length] = goal;
+            for (unsigned int k = length; k > 0; --k)
+                positions[k - 1] = positions[k] + glm::normalize(positions[k - 1] - positions[k]) * lengths[k - 1];
+
+            // Forward: pin the base back
+            positions[0] = base;
+            for (unsigned int k = 0; k < length; ++k)
+                positions[k + 1] = positions[k] + glm::normalize(positions[k + 1] - positions[k]) * lengths[k];
+        }
+    }
+
+    // Turn each bone so that its child lands on the solved position
+    for (unsigned int k = 0; k < length; ++k)
+    {
+        glm::vec3 const current = origin(world, chain[k + 1]) - origin(world, chain[k]);
+        rotate_bone(pose, chain[k], rotation_between(current, positions[k + 1] - origin(world, chain[k])), world);
+        for (unsigned int j = k; j <= length; ++j)
+            update_world(skeleton, pose, chain[j], world);
+    }
+}
+
+static void solve_targets(skeleton const & skeleton, pose & pose, ik_target const * targets, std::size_t count, ik_settings const & settings,
+    std::vector<glm::mat4x3> & world)
+{
+    for (auto const & target : std::span(targets, count))
+    {
+        if (target.weight <= 0.f)
+            continue;
+
+        unsigned int const length = chain_length(target);
+
+        // Animated rotations of the chain, for blending by the weight
+        unsigned int chain[max_chain_length];
+        glm::quat animated[max_chain_length];
+        for (unsigned int k = 0, bone = skeleton.parents[target.bone]; k < length; ++k, bone = skeleton.parents[bone])
+        {
+            chain[k] = bone;
+            animated[k] = pose.rotation[bone];
+        }
+
+        if (target.solver == ik_solver::two_bone)
+            solve_two_bone(skeleton, pose, target, world);
+        else
+            solve_fabrik(skeleton, pose, target, settings, world);
+
+        if (target.weight < 1.f)
+        {
+            for (unsigned int k = 0; k < length; ++k)
+            {
+                glm::quat solved = pose.rotation[chain[k]];
+                if (glm::dot(animated[k], solved) < 0.f)
+                    solved = -solved;
+                pose.rotation[chain[k]] = glm::normalize(animated[k] * (1.f - target.weight) + solved * target.weight);
+            }
+        }
+
+        // The solvers only keep the chain itself up to date, the next targets
+        // and the caller may need any bone below it
+        update_subtree(skeleton, pose, chain[length - 1], world);
+    }
+}
+
+void solve_ik(skeleton const & skeleton, pose & pose, std::vector<ik_target> const & targets, ik_settings const & settings, std::vector<glm::mat4x3> & world)
+{
+    for (auto const & target : targets)
+        validate(skeleton, target);
+
+    solve_targets(skeleton, pose, targets.data(), targets.size(), settings, world);
+}
+
+void solve_ik(skeleton const & skeleton, std::vector<pose> & poses, std::vector<ik_target> const & targets, std::size_t targets_per_pose,
+    ik_settings const & settings, thread_pool & pool)
+{
+    assert(targets.size() == poses.size() * targets_per_pose);
+
+    // Here rather than on the pool, where an exception would escape a worker thread
+    for (auto const & target : targets)
+        validate(skeleton, target);
+
+    pool.parallel_for(poses.size(), poses_per_job, [&](std::size_t begin, std::size_t end)
+    {
+        thread_local std::vector<glm::mat4x3> world, palette;
+
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            evaluate(skeleton, poses[i], world, palette);
+            solve_targets(skeleton, poses[i], targets.data() + i * targets_per_pose, targets_per_pose, settings, world);
+        }
+    });
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "pose.hpp"
+#include "skeleton.hpp"
+#include "thread_pool.hpp"
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x3.hpp>
+
+#include <optional>
+#include <vector>
+
+enum class ik_solver
+{
+    // Closed form for a joint with a parent and a grandparent, like a leg
+    two_bone,
+    // Forward and backward reaching over chain_length joints, like a tail or a neck
+    fabrik,
+};
+
+// Moves the origin of bone towards position by rotating the chain_length
+// bones above it; positions are in the space of the world transforms of
+// evaluate(). Only rotations change, the lengths of the chain stay the same,
+// and an unreachable target leaves the chain stretched towards it.
+struct ik_target
+{
+    unsigned int bone;
+    glm::vec3 position;
+
+    ik_solver solver = ik_solver::two_bone;
+    // Ignored by two_bone, which always rotates two bones; fabrik supports 1 to 16
+    unsigned int chain_length = 2;
+
+    // two_bone only: the middle joint bends towards this point, otherwise it
+    // keeps bending the way it did
+    std::optional<glm::vec3> pole;
+
+    // Blend between the animated (0) and the solved (1) rotations
+    float weight = 1.f;
+};
+
+struct ik_settings
+{
+    // FABRIK stops after this many iterations or once the end is this close
+    unsigned int max_iterations = 16;
+    float tolerance = 1e-4f;
+};
+
+// Solves the targets in order, each one starting from the result of the
+// previous ones. world holds the world transforms of the pose on entry
+// (see evaluate()) and is kept up to date for all the bones, not only the chains.
+// Throws before changing anything if a target's bone is out of range, its chain
+// length is unsupported, or the bone has fewer ancestors than the chain needs.
+void solve_ik(skeleton const & skeleton, pose & pose, std::vector<ik_target> const & targets, ik_settings const & settings, std::vector<glm::mat4x3> & world);
+
+// The same for many characters sharing a skeleton, targets_per_pose targets
+// for each pose: targets[i * targets_per_pose + k] belongs to poses[i]. Poses
+// are spread over the pool and solved independently. Throws like the above.
+void solve_ik(skeleton const & skeleton, std::vector<pose> & poses, std::vector<ik_target> const & targets, std::size_t targets_per_pose,
+    ik_settings const & settings, thread_pool & pool);
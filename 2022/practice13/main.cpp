@@ -12,10 +12,14 @@
 #include <iostream>
 #include <fstream>
 #include <chrono>
+#include <algorithm>
 #include <vector>
+#include <array>
 #include <random>
 #include <map>
 #include <cmath>
+#include <limits>
+#include <cstddef>
 
 #define GLM_FORCE_SWIZZLE
 #define GLM_ENABLE_EXPERIMENTAL
@@ -28,6 +32,17 @@
 #include <glm/gtx/string_cast.hpp>
 
 #include "gltf_loader.hpp"
+#include "animation_clip.hpp"
+#include "skeleton.hpp"
+#include "crowd.hpp"
+#include "blend_tree.hpp"
+#include "ik.hpp"
+#include "root_motion.hpp"
+#include "cpu_skinning.hpp"
+#include "skin_weights.hpp"
+#include "bone_bounds.hpp"
+#include "bone_palette.hpp"
+#include "vertex_animation.hpp"
 #include "stb_image.h"
 
 std::string to_string(std::string_view str)
@@ -52,17 +67,29 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+uniform int skinned;
+uniform mat4x3 bones[64];
+
 layout (location = 0) in vec3 in_position;
 layout (location = 1) in vec3 in_normal;
 layout (location = 2) in vec2 in_texcoord;
+layout (location = 3) in ivec4 in_joints;
+layout (location = 4) in vec4 in_weights;
 
 out vec3 normal;
 out vec2 texcoord;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(in_position, 1.0);
-    normal = mat3(model) * in_normal;
+    mat4x3 skin = mat4x3(1.0);
+    if (skinned == 1)
+        skin = bones[in_joints.x] * in_weights.x
+            + bones[in_joints.y] * in_weights.y
+            + bones[in_joints.z] * in_weights.z
+            + bones[in_joints.w] * in_weights.w;
+
+    gl_Position = projection * view * model * vec4(skin * vec4(in_position, 1.0), 1.0);
+    normal = mat3(model) * mat3(skin) * in_normal;
     texcoord = in_texcoord;
 }
 )";
@@ -136,8 +163,485 @@ GLuint create_program(Shaders ... shaders)
     return result;
 }
 
-int main() try
+// True if the box is entirely behind one of the planes of the frustum
+bool outside_frustum(glm::mat4 const & view_projection, bounding_box const & box)
+{
+    glm::mat4 const m = glm::transpose(view_projection);
+    for (glm::vec4 const & plane : {m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[3] + m[2], m[3] - m[2]})
+    {
+        // The corner furthest along the plane normal
+        glm::vec3 const corner(plane.x > 0.f ? box.max.x : box.min.x, plane.y > 0.f ? box.max.y : box.min.y, plane.z > 0.f ? box.max.z : box.min.z);
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.f)
+            return true;
+    }
+    return false;
+}
+
+// Wolves on a grid, each playing a random clip from a random time, every
+// fourth one blending two clips
+crowd make_wolf_crowd(gltf_model const & model, std::size_t count)
+{
+    auto const & skin = model.skins[0];
+
+    std::vector<std::string> names;
+    for (auto const & [name, animation] : skin.animations)
+        names.push_back(name);
+    std::sort(names.begin(), names.end());
+
+    std::vector<gltf_model::animation const *> animations;
+    for (auto const & name : names)
+        animations.push_back(&skin.animations.at(name));
+
+    crowd result;
+    result.rig = std::make_shared<skeleton>(make_skeleton(model, skin));
+
+    auto clips = std::make_shared<std::vector<std::vector<animation_clip>>>(make_crowd_clips(*result.rig, animations, {0.01f, 0.04f}));
+    result.clips = clips;
+
+    std::default_random_engine rng(count);
+    std::uniform_int_distribution<unsigned int> random_clip(0, clips->size() - 1);
+    std::uniform_real_distribution<float> random_phase(0.f, 1.f);
+
+    auto random_layer = [&](float weight)
+    {
+        crowd::layer layer;
+        layer.clip = random_clip(rng);
+        layer.time = random_phase(rng) * (*clips)[layer.clip][0].duration;
+        layer.speed = 0.8f + 0.4f * random_phase(rng);
+        layer.weight = weight;
+        return layer;
+    };
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto & instance = result.instances.emplace_back();
+        instance.layers.push_back(random_layer(1.f));
+        if (i % 4 == 3)
+            instance.layers.push_back(random_layer(random_phase(rng)));
+    }
+
+    return result;
+}
+
+// Headless: samples every bone of the wolf for every animation playing at
+// 60 fps, with the binary search per channel and with per-channel cursors
+void run_spline_sampling_benchmark()
+{
+    auto const input_model = load_gltf(std::string(PROJECT_ROOT) + "/wolf/Wolf-Blender-2.82a.gltf");
+    auto const & skin = input_model.skins[0];
+
+    int const frame_count = 20000;
+    float const dt = 1.f / 60.f;
+
+    for (auto const & [name, animation] : skin.animations)
+    {
+        std::size_t const bone_count = animation.bones.size();
+
+        std::vector<glm::vec3> translations(bone_count);
+        std::vector<glm::quat> rotations(bone_count);
+        std::vector<glm::vec3> scales(bone_count);
+
+        auto measure = [&](auto sample_bone)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int frame = 0; frame < frame_count; ++frame)
+            {
+                float const time = std::fmod(frame * dt, animation.max_time);
+                for (std::size_t i = 0; i < bone_count; ++i)
+                    sample_bone(i, time);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+
+            return std::chrono::duration_cast<std::chrono::duration<float, std::nano>>(end - start).count() / frame_count;
+        };
+
+        float const search_ns = measure([&](std::size_t i, float time)
+        {
+            auto const & bone = animation.bones[i];
+            translations[i] = bone.translation(time);
+            rotations[i] = bone.rotation(time);
+            scales[i] = bone.scale(time);
+        });
+
+        std::vector<std::array<std::size_t, 3>> cursors(bone_count, {0, 0, 0});
+        float const cursor_ns = measure([&](std::size_t i, float time)
+        {
+            auto const & bone = animation.bones[i];
+            translations[i] = bone.translation(time, cursors[i][0]);
+            rotations[i] = bone.rotation(time, cursors[i][1]);
+            scales[i] = bone.scale(time, cursors[i][2]);
+        });
+
+        // Both ways have to find the same keys, so the samples are exactly equal
+        std::size_t mismatch_count = 0;
+        std::fill(cursors.begin(), cursors.end(), std::array<std::size_t, 3>{0, 0, 0});
+        for (int frame = 0; frame < frame_count; ++frame)
+        {
+            float const time = std::fmod(frame * dt, animation.max_time);
+            for (std::size_t i = 0; i < bone_count; ++i)
+            {
+                auto const & bone = animation.bones[i];
+                if (bone.translation(time, cursors[i][0]) != bone.translation(time)
+                    || bone.rotation(time, cursors[i][1]) != bone.rotation(time)
+                    || bone.scale(time, cursors[i][2]) != bone.scale(time))
+                    ++mismatch_count;
+            }
+        }
+
+        std::size_t key_count = 0;
+        for (auto const & bone : animation.bones)
+            key_count += bone.translation.timestamps.size() + bone.rotation.timestamps.size() + bone.scale.timestamps.size();
+
+        std::cout << "sampling " << name << ": " << bone_count << " bones, " << (key_count / (3 * bone_count)) << " keys per channel, binary search "
+            << search_ns << " ns, cursors " << cursor_ns << " ns per skeleton, " << mismatch_count << " mismatching samples" << std::endl;
+    }
+}
+
+// Headless: updates a crowd for a while with one thread and with the whole
+// pool, then at every level of detail, reports the throughput and checks that
+// all thread counts give the same palettes
+void run_crowd_benchmark()
+{
+    auto const input_model = load_gltf(std::string(PROJECT_ROOT) + "/wolf/Wolf-Blender-2.82a.gltf");
+
+    std::size_t const instance_count = 1024;
+    int const frame_count = 200;
+    float const dt = 1.f / 60.f;
+
+    auto measure = [&](thread_pool & pool, crowd::lod lod)
+    {
+        crowd crowd = make_wolf_crowd(input_model, instance_count);
+        for (auto & instance : crowd.instances)
+            instance.lod = lod;
+        update(crowd, 0.f, pool);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int frame = 0; frame < frame_count; ++frame)
+            update(crowd, dt, pool);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        float const ms = std::chrono::duration_cast<std::chrono::duration<float, std::milli>>(end - start).count();
+        std::cout << pool.size() << " thread(s), every " << lod.interval << " frame(s), bone level " << lod.bone_level << ": "
+            << (instance_count * frame_count / ms) << " instances/ms" << std::endl;
+
+        return crowd.palettes;
+    };
+
+    thread_pool single(1);
+    thread_pool pool;
+
+    auto const expected = measure(single, {});
+    auto const palettes = measure(pool, {});
+
+    bool const same = std::equal(expected.begin(), expected.end(), palettes.begin());
+    std::cout << "results " << (same ? "match" : "differ") << std::endl;
+
+    // Distance between the bone origins at full detail and at a lower one
+    auto const & rig = *make_wolf_crowd(input_model, 0).rig;
+    for (crowd::lod lod : {crowd::lod{2, 0}, crowd::lod{2, 1}, crowd::lod{4, 2}})
+    {
+        auto const approximate = measure(pool, lod);
+
+        float max_error = 0.f;
+        for (std::size_t i = 0; i < palettes.size(); ++i)
+        {
+            // The palette moves the bind position of a bone to its current position
+            glm::mat4x3 const & inverse_bind_matrix = rig.inverse_bind_matrices[i % rig.size()];
+            glm::vec4 const bind_position = glm::inverse(glm::mat4(inverse_bind_matrix))[3];
+            max_error = std::max(max_error, glm::length(approximate[i] * bind_position - palettes[i] * bind_position));
+        }
+        std::cout << "    max bone offset error: " << max_error << std::endl;
+    }
+}
+
+// Headless: run, walk and creep blended by two weights with the idle animation
+// added on top, evaluated for many wolves as a blend tree
+void run_blend_tree_benchmark()
+{
+    auto const input_model = load_gltf(std::string(PROJECT_ROOT) + "/wolf/Wolf-Blender-2.82a.gltf");
+    auto const & skin = input_model.skins[0];
+    skeleton const rig = make_skeleton(input_model, skin);
+
+    std::vector<animation_clip> clips;
+    for (auto name : {"01_Run", "02_walk", "03_creep", "04_Idle"})
+        clips.push_back(make_clip(skin.animations.at(name)));
+
+    blend_tree tree;
+    auto const run = tree.add_sample(0);
+    auto const walk = tree.add_sample(1);
+    auto const creep = tree.add_sample(2);
+    auto const idle = tree.add_sample(3);
+    auto const idle_reference = tree.add_sample(3);
+    auto const locomotion = tree.add_blend(tree.add_blend(walk, run), creep);
+    tree.add_additive(locomotion, idle, idle_reference);
+
+    unsigned int const clip_nodes[] = {run, walk, creep, idle};
+
+    compiled_blend_tree const compiled = compile(tree);
+
+    std::size_t const instance_count = 1024;
+    int const frame_count = 100;
+    float const dt = 1.f / 60.f;
+
+    auto measure = [&](thread_pool & pool)
+    {
+        // Random clip times and weights, the idle reference stays at the start
+        std::default_random_engine rng(instance_count);
+        std::uniform_real_distribution<float> random(0.f, 1.f);
+
+        std::vector<blend_tree_instance> instances(instance_count);
+        for (auto & instance : instances)
+        {
+            instance.parameters.resize(compiled.parameter_count);
+            for (auto & parameter : instance.parameters)
+                parameter = random(rng);
+            instance.parameters[tree.nodes[idle_reference].parameter] = 0.f;
+        }
+
+        blend_arena arena;
+        std::vector<pose> results;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int frame = 0; frame < frame_count; ++frame)
+        {
+            for (auto & instance : instances)
+                for (unsigned int clip = 0; clip < clips.size(); ++clip)
+                {
+                    float & time = instance.parameters[tree.nodes[clip_nodes[clip]].parameter];
+                    time = std::fmod(time + dt, clips[clip].duration);
+                }
+
+            evaluate(compiled, clips, rig.rest_pose, instances, arena, results, pool);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        float const ms = std::chrono::duration_cast<std::chrono::duration<float, std::milli>>(end - start).count();
+        std::cout << "blend tree, " << pool.size() << " thread(s): " << (instance_count * frame_count / ms) << " instances/ms" << std::endl;
+
+        return results;
+    };
+
+    thread_pool single(1);
+    thread_pool pool;
+
+    auto const expected = measure(single);
+    auto const results = measure(pool);
+
+    bool same = true;
+    for (std::size_t i = 0; i < expected.size(); ++i)
+        same = same && expected[i].translation == results[i].translation && expected[i].rotation == results[i].rotation && expected[i].scale == results[i].scale;
+    std::cout << "results " << (same ? "match" : "differ") << std::endl;
+}
+
+// Headless: plants the paws of running wolves 2cm lower than the animation
+// puts them and bends the tail towards a point, for many wolves at once
+void run_ik_benchmark()
 {
+    auto const input_model = load_gltf(std::string(PROJECT_ROOT) + "/wolf/Wolf-Blender-2.82a.gltf");
+    auto const & skin = input_model.skins[0];
+    skeleton const rig = make_skeleton(input_model, skin);
+    animation_clip const clip = make_clip(skin.animations.at("01_Run"));
+
+    auto find_bone = [&](std::string_view name)
+    {
+        for (std::size_t i = 0; i < skin.bones.size(); ++i)
+            if (skin.bones[i].name.starts_with(name))
+                return (unsigned int)i;
+        throw std::runtime_error("No bone " + std::string(name));
+    };
+
+    unsigned int const paws[] = {find_bone("Vorderpfote_L"), find_bone("Vorderpfote_R"), find_bone("Pfote2_L"), find_bone("Pfote2_R")};
+    unsigned int const tail = find_bone("Schwanz_003");
+
+    std::size_t const pose_count = 1024;
+    std::size_t const targets_per_pose = std::size(paws) + 1;
+
+    std::vector<pose> poses(pose_count, rig.rest_pose);
+    std::vector<ik_target> targets;
+    std::vector<glm::mat4x3> world, palette;
+    std::vector<std::size_t> cursors;
+    for (std::size_t i = 0; i < pose_count; ++i)
+    {
+        sample(clip, clip.duration * i / pose_count, poses[i], cursors);
+        evaluate(rig, poses[i], world, palette);
+
+        for (auto paw : paws)
+            targets.push_back({paw, glm::vec3(world[paw][3]) - glm::vec3(0.f, 0.02f, 0.f)});
+        targets.push_back({tail, glm::vec3(world[tail][3]) + glm::vec3(0.f, 0.05f, 0.f), ik_solver::fabrik, 3});
+    }
+
+    thread_pool pool;
+    auto solved = poses;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    solve_ik(rig, solved, targets, targets_per_pose, {}, pool);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    float max_error = 0.f;
+    for (std::size_t i = 0; i < pose_count; ++i)
+    {
+        evaluate(rig, solved[i], world, palette);
+        for (std::size_t k = 0; k < targets_per_pose; ++k)
+        {
+            auto const & target = targets[i * targets_per_pose + k];
+            max_error = std::max(max_error, glm::distance(glm::vec3(world[target.bone][3]), target.position));
+        }
+    }
+
+    float const ms = std::chrono::duration_cast<std::chrono::duration<float, std::milli>>(end - start).count();
+    std::cout << "ik, " << pool.size() << " thread(s): " << (pose_count / ms) << " poses/ms with " << targets_per_pose
+        << " targets each, max distance to target " << max_error << std::endl;
+}
+
+// Headless: takes the ground motion of the pelvis out of every clip and
+// measures the cost of querying it
+void run_root_motion_benchmark()
+{
+    auto const input_model = load_gltf(std::string(PROJECT_ROOT) + "/wolf/Wolf-Blender-2.82a.gltf");
+    auto const & skin = input_model.skins[0];
+    skeleton const rig = make_skeleton(input_model, skin);
+
+    unsigned int pelvis = -1;
+    for (std::size_t i = 0; i < skin.bones.size(); ++i)
+        if (skin.bones[i].name.starts_with("Becken"))
+            pelvis = i;
+
+    for (auto const & [name, animation] : skin.animations)
+    {
+        auto in_place = animation;
+        root_motion const motion = extract_root_motion(rig, in_place, pelvis);
+
+        float sway = 0.f;
+        for (auto const & displacement : motion.displacements)
+            sway = std::max(sway, glm::length(displacement));
+
+        int const queries = 1000000;
+        float const dt = 1.f / 60.f;
+        glm::vec3 travelled(0.f);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < queries; ++i)
+            travelled += displacement(motion, i * dt, (i + 1) * dt);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        float const ns = std::chrono::duration_cast<std::chrono::duration<float, std::nano>>(end - start).count() / queries;
+        std::cout << "root motion " << name << ": " << motion.displacements.size() << " samples, per loop " << glm::to_string(motion.cycle)
+            << ", max sway " << sway << ", " << ns << " ns per query" << std::endl;
+    }
+}
+
+// Headless: skins every skinned mesh of the wolf on the CPU in both modes
+void run_skinning_benchmark()
+{
+    auto const input_model = load_gltf(std::string(PROJECT_ROOT) + "/wolf/Wolf-Blender-2.82a.gltf");
+
+    crowd wolves = make_wolf_crowd(input_model, 1);
+    thread_pool pool;
+    update(wolves, 0.f, pool);
+
+    std::vector<glm::mat4x3> const palette(wolves.palette(0), wolves.palette(0) + wolves.rig->size());
+
+    std::vector<skinned_mesh> meshes;
+    std::size_t vertex_count = 0;
+    for (auto const & mesh : input_model.meshes)
+        if (mesh.skin != -1)
+        {
+            meshes.push_back(read_skinned_mesh(input_model, mesh));
+            vertex_count += meshes.back().positions.size();
+        }
+
+    // Same meshes with pruned, quantized and grouped weights
+    std::vector<skinned_mesh> processed_meshes = meshes;
+    for (auto & mesh : processed_meshes)
+        process_skin_weights(mesh);
+
+    int const iterations = 200;
+
+    struct skinning_run
+    {
+        char const * name;
+        skinning_mode mode;
+        std::vector<skinned_mesh> const & meshes;
+    };
+
+    for (auto const & run : {
+        skinning_run{"linear", skinning_mode::linear, meshes},
+        skinning_run{"dual quaternion", skinning_mode::dual_quaternion, meshes},
+        skinning_run{"linear, processed weights", skinning_mode::linear, processed_meshes},
+    })
+    {
+        skinned_vertices result;
+        bounding_box bounds;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            bounds = {};
+            for (auto const & mesh : run.meshes)
+            {
+                skin(mesh, palette, run.mode, result, pool);
+                bounds.extend(result.bounds);
+            }
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        float const us = std::chrono::duration_cast<std::chrono::duration<float, std::micro>>(end - start).count() / iterations;
+        std::cout << run.name << " skinning: " << vertex_count << " vertices in " << us << " us, bounds "
+            << glm::to_string(bounds.min) << " - " << glm::to_string(bounds.max) << std::endl;
+    }
+}
+
+// Headless: bakes every skinned mesh of the wolf playing a clip into a vertex
+// animation texture in the current directory and reports the error
+void run_vertex_animation_baker(std::string const & clip_name, float frame_rate)
+{
+    auto const input_model = load_gltf(std::string(PROJECT_ROOT) + "/wolf/Wolf-Blender-2.82a.gltf");
+    auto const & skin = input_model.skins[0];
+
+    auto const model_skeleton = make_skeleton(input_model, skin);
+    auto const clip = make_clip(skin.animations.at(clip_name));
+    thread_pool pool;
+
+    for (std::size_t i = 0; i < input_model.meshes.size(); ++i)
+    {
+        auto const & mesh = input_model.meshes[i];
+        if (mesh.skin == -1)
+            continue;
+
+        vertex_animation_error error;
+        auto const texture = bake_vertex_animation(read_skinned_mesh(input_model, mesh), model_skeleton, clip, frame_rate, pool, &error);
+
+        std::string const path = clip_name + "_" + std::to_string(i) + ".vat";
+        save_vertex_animation(texture, path);
+
+        std::cout << path << ": " << texture.vertex_count << "x" << texture.frame_count << " texels, "
+            << (texture.texels.size() * sizeof(texture.texels[0])) << " bytes" << std::endl;
+        std::cout << "    position error max " << error.max_position_error << " mean " << error.mean_position_error << std::endl;
+        std::cout << "    between frames max " << error.max_interpolation_error << " mean " << error.mean_interpolation_error << std::endl;
+        std::cout << "    normal error max " << glm::degrees(error.max_normal_error) << " mean " << glm::degrees(error.mean_normal_error) << " degrees" << std::endl;
+    }
+}
+
+int main(int argc, char ** argv) try
+{
+    if (argc > 1 && std::string_view(argv[1]) == "--benchmark")
+    {
+        run_spline_sampling_benchmark();
+        run_crowd_benchmark();
+        run_blend_tree_benchmark();
+        run_ik_benchmark();
+        run_root_motion_benchmark();
+        run_skinning_benchmark();
+        return 0;
+    }
+
+    // practice13 --bake [clip] [frame rate]
+    if (argc > 1 && std::string_view(argv[1]) == "--bake")
+    {
+        run_vertex_animation_baker(argc > 2 ? argv[2] : "01_Run", argc > 3 ? std::stof(argv[3]) : 30.f);
+        return 0;
+    }
+
     if (SDL_Init(SDL_INIT_VIDEO) != 0)
         sdl2_fail("SDL_Init: ");
 
@@ -185,49 +689,136 @@ int main() try
     GLuint color_location = glGetUniformLocation(program, "color");
     GLuint use_texture_location = glGetUniformLocation(program, "use_texture");
     GLuint light_direction_location = glGetUniformLocation(program, "light_direction");
+    GLuint skinned_location = glGetUniformLocation(program, "skinned");
+    GLuint bones_location = glGetUniformLocation(program, "bones");
 
     const std::string project_root = PROJECT_ROOT;
     const std::string model_path = project_root + "/wolf/Wolf-Blender-2.82a.gltf";
 
     auto const input_model = load_gltf(model_path);
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, input_model.buffer.size(), input_model.buffer.data(), GL_STATIC_DRAW);
+
+    std::vector<GLuint> vbos(input_model.buffers.size());
+    glGenBuffers(vbos.size(), vbos.data());
+    for (std::size_t i = 0; i < vbos.size(); ++i)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, vbos[i]);
+        glBufferData(GL_ARRAY_BUFFER, input_model.buffers[i].size(), input_model.buffers[i].data(), GL_STATIC_DRAW);
+    }
+
+    // Skinned meshes are drawn in parts with their own vertex buffers and a
+    // palette of only the bones they use
+    struct skinned_part
+    {
+        GLuint vao;
+        GLsizei index_count;
+        std::vector<std::uint16_t> bones;
+    };
 
     struct mesh
     {
         GLuint vao;
-        gltf_model::accessor indices;
+        GLenum mode;
+        std::optional<gltf_model::accessor> indices;
+        GLsizei vertex_count;
         gltf_model::material material;
+        std::vector<unsigned int> instances;
+        unsigned int skin;
+        std::vector<skinned_part> parts;
+    };
+
+    // Size of the bones array in the vertex shader
+    std::size_t const max_palette_size = 64;
+
+    struct skinned_vertex
+    {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec2 texcoord;
+        std::array<std::uint16_t, 4> joints;
+        glm::vec4 weights;
     };
 
-    auto setup_attribute = [](int index, gltf_model::accessor const & accessor, bool integer = false)
+    auto make_skinned_parts = [&](gltf_model::mesh const & mesh)
     {
+        auto const skinned = read_skinned_mesh(input_model, mesh);
+        auto const texcoords = mesh.texcoord ? read_accessor<glm::vec2>(input_model, *mesh.texcoord) : std::vector<glm::vec2>(skinned.positions.size());
+
+        std::vector<skinned_part> result;
+        for (auto const & submesh : split_by_bones(skinned, read_triangles(input_model, mesh), max_palette_size))
+        {
+            std::vector<skinned_vertex> vertices;
+            for (std::size_t i = 0; i < submesh.vertices.size(); ++i)
+            {
+                std::uint32_t const v = submesh.vertices[i];
+                vertices.push_back({skinned.positions[v], skinned.normals.empty() ? glm::vec3(0.f) : skinned.normals[v], texcoords[v], submesh.joints[i], skinned.weights[v]});
+            }
+
+            auto & part = result.emplace_back();
+            part.index_count = submesh.indices.size();
+            part.bones = submesh.bones;
+
+            GLuint buffers[2];
+            glGenBuffers(2, buffers);
+            glGenVertexArrays(1, &part.vao);
+            glBindVertexArray(part.vao);
+
+            glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vertices[0]), vertices.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, submesh.indices.size() * sizeof(submesh.indices[0]), submesh.indices.data(), GL_STATIC_DRAW);
+
+            for (int index = 0; index < 5; ++index)
+                glEnableVertexAttribArray(index);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(skinned_vertex), reinterpret_cast<void *>(offsetof(skinned_vertex, position)));
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(skinned_vertex), reinterpret_cast<void *>(offsetof(skinned_vertex, normal)));
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(skinned_vertex), reinterpret_cast<void *>(offsetof(skinned_vertex, texcoord)));
+            glVertexAttribIPointer(3, 4, GL_UNSIGNED_SHORT, sizeof(skinned_vertex), reinterpret_cast<void *>(offsetof(skinned_vertex, joints)));
+            glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(skinned_vertex), reinterpret_cast<void *>(offsetof(skinned_vertex, weights)));
+        }
+        return result;
+    };
+
+    auto setup_attribute = [&](int index, std::optional<gltf_model::accessor> const & accessor, bool integer = false)
+    {
+        if (!accessor)
+            return;
+
+        glBindBuffer(GL_ARRAY_BUFFER, vbos[accessor->view.buffer]);
         glEnableVertexAttribArray(index);
         if (integer)
-            glVertexAttribIPointer(index, accessor.size, accessor.type, 0, reinterpret_cast<void *>(accessor.view.offset));
+            glVertexAttribIPointer(index, accessor->size, accessor->type, accessor->view.stride, reinterpret_cast<void *>(accessor->view.offset));
         else
-            glVertexAttribPointer(index, accessor.size, accessor.type, GL_FALSE, 0, reinterpret_cast<void *>(accessor.view.offset));
+            glVertexAttribPointer(index, accessor->size, accessor->type, accessor->normalized, accessor->view.stride, reinterpret_cast<void *>(accessor->view.offset));
     };
 
     std::vector<mesh> meshes;
     for (auto const & mesh : input_model.meshes)
     {
         auto & result = meshes.emplace_back();
+        result.material = mesh.material;
+        result.instances = mesh.instances;
+        result.skin = mesh.skin;
+
+        if (mesh.skin != -1)
+        {
+            result.parts = make_skinned_parts(mesh);
+            continue;
+        }
+
         glGenVertexArrays(1, &result.vao);
         glBindVertexArray(result.vao);
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo);
+        if (mesh.indices)
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbos[mesh.indices->view.buffer]);
+        result.mode = mesh.mode;
         result.indices = mesh.indices;
+        result.vertex_count = mesh.position.count;
 
         setup_attribute(0, mesh.position);
         setup_attribute(1, mesh.normal);
         setup_attribute(2, mesh.texcoord);
         setup_attribute(3, mesh.joints, true);
         setup_attribute(4, mesh.weights);
-
-        result.material = mesh.material;
     }
 
     std::map<std::string, GLuint> textures;
@@ -255,14 +846,44 @@ int main() try
         textures[*mesh.material.texture_path] = texture;
     }
 
-    auto last_frame_start = std::chrono::high_resolution_clock::now();
+    // All the meshes of the wolf share the first skin
+    std::size_t const crowd_side = 16;
+    float const crowd_spacing = 0.75f;
+    crowd wolves = make_wolf_crowd(input_model, crowd_side * crowd_side);
+    thread_pool pool;
 
-    float time = 0.f;
+    auto wolf_offset = [&](std::size_t wolf)
+    {
+        return glm::vec3((wolf % crowd_side - (crowd_side - 1) * 0.5f) * crowd_spacing, 0.f, (wolf / crowd_side - (crowd_side - 1) * 0.5f) * crowd_spacing);
+    };
+
+    // Bounding sphere of the joints in the bind pose, for choosing the level of detail
+    glm::vec3 joints_min(std::numeric_limits<float>::infinity());
+    glm::vec3 joints_max(-std::numeric_limits<float>::infinity());
+    for (auto const & inverse_bind_matrix : wolves.rig->inverse_bind_matrices)
+    {
+        glm::vec3 const joint = glm::inverse(glm::mat4(inverse_bind_matrix))[3];
+        joints_min = glm::min(joints_min, joint);
+        joints_max = glm::max(joints_max, joint);
+    }
+    glm::vec3 const wolf_center = (joints_min + joints_max) * 0.5f;
+    float const wolf_radius = glm::distance(joints_min, joints_max) * 0.5f;
+
+    // Bind pose boxes of the bones, for culling the wolves in their current pose
+    std::vector<bounding_box> bone_bounds(wolves.rig->size());
+    for (auto const & mesh : input_model.meshes)
+        if (mesh.skin != -1)
+            add_bone_bounds(read_skinned_mesh(input_model, mesh), bone_bounds);
+
+    std::vector<bool> wolf_visible;
+    std::vector<glm::mat4x3> part_palette;
+
+    auto last_frame_start = std::chrono::high_resolution_clock::now();
 
     std::map<SDL_Keycode, bool> button_down;
 
     float view_angle = glm::pi<float>() / 8.f;
-    float camera_distance = 0.75f;
+    float camera_distance = 4.f;
 
     float camera_rotation = glm::pi<float>() * (- 1.f / 3.f);
     float camera_height = 0.25f;
@@ -303,9 +924,6 @@ int main() try
         float dt = std::chrono::duration_cast<std::chrono::duration<float>>(now - last_frame_start).count();
         last_frame_start = now;
 
-        if (!paused)
-            time += dt;
-
         if (button_down[SDLK_UP])
             camera_distance -= 3.f * dt;
         if (button_down[SDLK_DOWN])
@@ -351,6 +969,24 @@ int main() try
         glUniformMatrix4fv(projection_location, 1, GL_FALSE, reinterpret_cast<float *>(&projection));
         glUniform3fv(light_direction_location, 1, reinterpret_cast<float *>(&light_direction));
 
+        // Fraction of the screen height covered by each wolf, the field of view is 90 degrees
+        for (std::size_t wolf = 0; wolf < wolves.instances.size(); ++wolf)
+        {
+            float const distance = std::max(near, glm::distance(camera_position, wolf_offset(wolf) + wolf_center));
+            wolves.instances[wolf].lod = select_lod(wolf_radius / distance);
+        }
+
+        update(wolves, paused ? 0.f : dt, pool);
+
+        wolf_visible.resize(wolves.instances.size());
+        for (std::size_t wolf = 0; wolf < wolves.instances.size(); ++wolf)
+        {
+            bounding_box box = posed_bounds(bone_bounds, wolves.palette(wolf));
+            box.min += wolf_offset(wolf);
+            box.max += wolf_offset(wolf);
+            wolf_visible[wolf] = !outside_frustum(projection * view * model, box);
+        }
+
         auto draw_meshes = [&](bool transparent)
         {
             for (auto const & mesh : meshes)
@@ -381,8 +1017,52 @@ int main() try
                 else
                     continue;
 
+                glUniform1i(skinned_location, mesh.skin != -1);
+
+                if (mesh.skin != -1)
+                {
+                    for (auto const & part : mesh.parts)
+                    {
+                        glBindVertexArray(part.vao);
+
+                        for (std::size_t wolf = 0; wolf < wolves.instances.size(); ++wolf)
+                        {
+                            if (!wolf_visible[wolf])
+                                continue;
+
+                            // Only the bones of this part are uploaded
+                            gather_palette(part.bones, wolves.palette(wolf), part_palette);
+                            glUniformMatrix4x3fv(bones_location, part_palette.size(), GL_FALSE, reinterpret_cast<float const *>(part_palette.data()));
+
+                            // Skinned meshes are placed by their bones, not by the node
+                            glm::mat4 const wolf_model = glm::translate(model, wolf_offset(wolf));
+                            glUniformMatrix4fv(model_location, 1, GL_FALSE, reinterpret_cast<float const *>(&wolf_model));
+
+                            for (std::size_t instance = 0; instance < mesh.instances.size(); ++instance)
+                                glDrawElements(GL_TRIANGLES, part.index_count, GL_UNSIGNED_INT, nullptr);
+                        }
+                    }
+                    continue;
+                }
+
                 glBindVertexArray(mesh.vao);
-                glDrawElements(GL_TRIANGLES, mesh.indices.count, mesh.indices.type, reinterpret_cast<void *>(mesh.indices.view.offset));
+
+                for (std::size_t wolf = 0; wolf < wolves.instances.size(); ++wolf)
+                {
+                    glm::mat4 const wolf_model = glm::translate(model, wolf_offset(wolf));
+
+                    // A mesh is uploaded once and drawn for every node that refers to it
+                    for (auto instance : mesh.instances)
+                    {
+                        glm::mat4 const instance_model = wolf_model * input_model.world_transforms[instance];
+                        glUniformMatrix4fv(model_location, 1, GL_FALSE, reinterpret_cast<float const *>(&instance_model));
+
+                        if (mesh.indices)
+                            glDrawElements(mesh.mode, mesh.indices->count, mesh.indices->type, reinterpret_cast<void *>(mesh.indices->view.offset));
+                        else
+                            glDrawArrays(mesh.mode, 0, mesh.vertex_count);
+                    }
+                }
             }
         };
 
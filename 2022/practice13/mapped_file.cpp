@@ -0,0 +1,92 @@
+#include "mapped_file.hpp"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+mapped_file::mapped_file(std::filesystem::path const & path)
+{
+    length = std::filesystem::file_size(path);
+
+    // Zero-sized files can't be mapped
+    if (length == 0)
+        return;
+
+    file_handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE)
+    {
+        file_handle = nullptr;
+        throw std::runtime_error("Failed to open " + path.string());
+    }
+
+    mapping_handle = CreateFileMappingW(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_handle)
+    {
+        CloseHandle(file_handle);
+        throw std::runtime_error("Failed to map " + path.string());
+    }
+
+    pointer = static_cast<char const *>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    if (!pointer)
+    {
+        CloseHandle(mapping_handle);
+        CloseHandle(file_handle);
+        throw std::runtime_error("Failed to map " + path.string());
+    }
+}
+
+mapped_file::~mapped_file()
+{
+    if (pointer)
+        UnmapViewOfFile(pointer);
+    if (mapping_handle)
+        CloseHandle(mapping_handle);
+    if (file_handle)
+        CloseHandle(file_handle);
+}
+
+#else
+
+mapped_file::mapped_file(std::filesystem::path const & path)
+{
+    int const fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        throw std::runtime_error("Failed to open " + path.string());
+
+    length = std::filesystem::file_size(path);
+
+    // Zero-sized files can't be mapped
+    if (length == 0)
+    {
+        close(fd);
+        return;
+    }
+
+    void * address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping keeps the file alive by itself
+    close(fd);
+
+    if (address == MAP_FAILED)
+        throw std::runtime_error("Failed to map " + path.string());
+
+    pointer = static_cast<char const *>(address);
+}
+
+mapped_file::~mapped_file()
+{
+    if (pointer)
+        munmap(const_cast<char *>(pointer), length);
+}
+
+#endif
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <filesystem>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. The pages are loaded by the OS
+// on first access, so opening even a huge file is cheap.
+class mapped_file
+{
+public:
+    explicit mapped_file(std::filesystem::path const & path);
+    ~mapped_file();
+
+    mapped_file(mapped_file const &) = delete;
+    mapped_file & operator = (mapped_file const &) = delete;
+
+    char const * data() const { return pointer; }
+    std::size_t size() const { return length; }
+
+private:
+    char const * pointer = nullptr;
+    std::size_t length = 0;
+
+#ifdef _WIN32
+    void * file_handle = nullptr;
+    void * mapping_handle = nullptr;
+#endif
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+
+// Local transforms of all the bones of a skeleton, one array per component
+struct pose
+{
+    std::vector<glm::vec3> translation;
+    std::vector<glm::quat> rotation;
+    std::vector<glm::vec3> scale;
+
+    std::size_t size() const { return translation.size(); }
+
+    // New bones get the identity transform
+    void resize(std::size_t size)
+    {
+        translation.resize(size, glm::vec3(0.f));
+        rotation.resize(size, glm::quat(1.f, 0.f, 0.f, 0.f));
+        scale.resize(size, glm::vec3(1.f));
+    }
+};
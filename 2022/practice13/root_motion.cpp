@@ -0,0 +1,84 @@
+#include "root_motion.hpp"
+
+#include <glm/geometric.hpp>
+#include <glm/mat3x3.hpp>
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+glm::vec3 root_motion::at(float time) const
+{
+    float const position = glm::clamp(time, 0.f, duration) * sample_rate;
+    std::size_t const sample = std::min<std::size_t>(position, displacements.size() - 2);
+    float const t = std::min(position - sample, 1.f);
+    return displacements[sample] + (displacements[sample + 1] - displacements[sample]) * t;
+}
+
+root_motion extract_root_motion(skeleton const & skeleton, gltf_model::animation & animation, unsigned int bone, float sample_rate, glm::vec3 const & up)
+{
+    auto & channel = animation.bones.at(bone).translation;
+    if (channel.values.empty())
+        throw std::runtime_error("The animation doesn't translate bone " + std::to_string(bone));
+
+    root_motion result;
+    result.bone = bone;
+
+    // Mesh space of the parent of the bone at the start of the clip
+    pose start_pose = skeleton.rest_pose;
+    for (unsigned int i = skeleton.parents[bone]; i != skeleton::no_parent; i = skeleton.parents[i])
+    {
+        auto const & ancestor = animation.bones[i];
+        if (!ancestor.translation.values.empty()) start_pose.translation[i] = ancestor.translation(0.f);
+        if (!ancestor.rotation.values.empty()) start_pose.rotation[i] = ancestor.rotation(0.f);
+        if (!ancestor.scale.values.empty()) start_pose.scale[i] = ancestor.scale(0.f);
+    }
+
+    std::vector<glm::mat4x3> world, palette;
+    evaluate(skeleton, start_pose, world, palette);
+    unsigned int const parent = skeleton.parents[bone];
+    glm::mat3 const to_mesh(parent == skeleton::no_parent ? skeleton.root_transform : world[parent]);
+    glm::mat3 const to_local = glm::inverse(to_mesh);
+
+    // Ground plane part of a mesh space vector
+    glm::vec3 const normal = glm::normalize(up);
+    auto ground = [&](glm::vec3 const & v)
+    {
+        return v - normal * glm::dot(v, normal);
+    };
+
+    glm::vec3 const start = channel(0.f);
+    auto motion = [&](float time)
+    {
+        return ground(to_mesh * (channel(time) - start));
+    };
+
+    result.duration = animation.max_time;
+
+    std::size_t const steps = std::max<std::size_t>(1, std::lround(result.duration * sample_rate));
+    result.sample_rate = result.duration > 0.f ? steps / result.duration : 0.f;
+
+    for (std::size_t step = 0; step <= steps; ++step)
+        result.displacements.push_back(motion(result.duration * step / steps));
+    result.cycle = result.displacements.back();
+
+    // The motion is linear in the translation, so taking it out of every key
+    // (and every tangent) takes it out of the interpolated curve as well
+    for (std::size_t key = 0; key < channel.values.size(); ++key)
+        channel.values[key] -= to_local * ground(to_mesh * (channel.values[key] - start));
+    for (auto * tangents : {&channel.in_tangents, &channel.out_tangents})
+        for (auto & tangent : *tangents)
+            tangent -= to_local * ground(to_mesh * tangent);
+
+    return result;
+}
+
+glm::vec3 displacement(root_motion const & motion, float from, float to)
+{
+    if (motion.duration <= 0.f)
+        return glm::vec3(0.f);
+
+    float const from_loop = std::floor(from / motion.duration);
+    float const to_loop = std::floor(to / motion.duration);
+    return motion.at(to - to_loop * motion.duration) - motion.at(from - from_loop * motion.duration) + motion.cycle * (to_loop - from_loop);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "gltf_loader.hpp"
+#include "skeleton.hpp"
+
+#include <glm/vec3.hpp>
+
+#include <vector>
+
+// Movement of a clip along the ground, taken out of the translation of its
+// root bone and resampled at a fixed rate, so that the displacement over any
+// time interval costs O(1) and doesn't need the skeleton
+struct root_motion
+{
+    // The bone the motion was taken from
+    unsigned int bone = 0;
+
+    float duration = 0.f;
+    // Samples per second, adjusted so that the clip is a whole number of steps
+    float sample_rate = 0.f;
+
+    // Mesh space displacement since the start of the clip at every sample, the
+    // last one at the end of the clip: the displacement between two samples
+    // is the difference of their entries
+    std::vector<glm::vec3> displacements;
+
+    // Displacement over one loop of the clip
+    glm::vec3 cycle{0.f};
+
+    // Displacement since the start of the clip, time is clamped to [0, duration]
+    glm::vec3 at(float time) const;
+};
+
+// Takes the motion perpendicular to up out of the translation channel of the
+// bone, usually the pelvis. The bones above it are assumed to keep their pose
+// from the start of the clip; the vertical motion, like the bobbing of a run,
+// stays in the channel. The pose at the start of the clip doesn't change.
+root_motion extract_root_motion(skeleton const & skeleton, gltf_model::animation & animation, unsigned int bone, float sample_rate = 60.f,
+    glm::vec3 const & up = glm::vec3(0.f, 1.f, 0.f));
+
+// Movement between two times of the looping clip, any number of loops apart
+glm::vec3 displacement(root_motion const & motion, float from, float to);
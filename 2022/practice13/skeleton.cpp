@@ -0,0 +1,73 @@
+#include "skeleton.hpp"
+
+#include <glm/mat3x3.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cassert>
+
+static glm::mat4x3 affine(glm::mat4 const & m)
+{
+    return glm::mat4x3(glm::vec3(m[0]), glm::vec3(m[1]), glm::vec3(m[2]), glm::vec3(m[3]));
+}
+
+glm::mat4x3 compose(glm::mat4x3 const & a, glm::mat4x3 const & b)
+{
+    glm::mat4x3 result;
+    for (int c = 0; c < 4; ++c)
+        result[c] = a[0] * b[c].x + a[1] * b[c].y + a[2] * b[c].z;
+    result[3] += a[3];
+    return result;
+}
+
+skeleton make_skeleton(gltf_model const & model, gltf_model::skin const & skin)
+{
+    skeleton result;
+    result.rest_pose.resize(skin.bones.size());
+
+    for (std::size_t i = 0; i < skin.bones.size(); ++i)
+    {
+        auto const & bone = skin.bones[i];
+        assert(bone.parent == skeleton::no_parent || bone.parent < i);
+
+        result.parents.push_back(bone.parent);
+        result.inverse_bind_matrices.push_back(affine(bone.inverse_bind_matrix));
+
+        // Node transforms are stored as matrices, split them back into TRS
+        glm::mat4 const & local = model.local_transforms[bone.node];
+        glm::vec3 const scale(glm::length(glm::vec3(local[0])), glm::length(glm::vec3(local[1])), glm::length(glm::vec3(local[2])));
+
+        result.rest_pose.translation[i] = glm::vec3(local[3]);
+        result.rest_pose.rotation[i] = glm::normalize(glm::quat_cast(glm::mat3(glm::vec3(local[0]) / scale.x, glm::vec3(local[1]) / scale.y, glm::vec3(local[2]) / scale.z)));
+        result.rest_pose.scale[i] = scale;
+
+        if (bone.parent == skeleton::no_parent)
+        {
+            unsigned int const parent_node = model.nodes[bone.node].parent;
+            if (parent_node != skeleton::no_parent)
+                result.root_transform = affine(model.world_transforms[parent_node]);
+        }
+    }
+
+    return result;
+}
+
+void evaluate(skeleton const & skeleton, pose const & local, std::vector<glm::mat4x3> & world, std::vector<glm::mat4x3> & palette)
+{
+    std::size_t const size = skeleton.size();
+    assert(local.size() >= size);
+
+    world.resize(size);
+    palette.resize(size);
+
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        glm::mat3 const rotation = glm::mat3_cast(local.rotation[i]);
+        glm::vec3 const & scale = local.scale[i];
+        glm::mat4x3 const transform(rotation[0] * scale.x, rotation[1] * scale.y, rotation[2] * scale.z, local.translation[i]);
+
+        // The parent has been computed already
+        unsigned int const parent = skeleton.parents[i];
+        world[i] = compose(parent == skeleton::no_parent ? skeleton.root_transform : world[parent], transform);
+        palette[i] = compose(world[i], skeleton.inverse_bind_matrices[i]);
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "gltf_loader.hpp"
+#include "pose.hpp"
+
+#include <glm/mat4x3.hpp>
+
+#include <vector>
+#include <cstdint>
+
+// Everything about a skin that doesn't depend on the pose. Bones are ordered so
+// that parents go before children, transforms are affine 3x4 matrices.
+struct skeleton
+{
+    // Parent of the root bones, the same as in gltf_model
+    static constexpr unsigned int no_parent = std::uint32_t(-1);
+
+    std::vector<unsigned int> parents;
+    std::vector<glm::mat4x3> inverse_bind_matrices;
+
+    // Local transforms of the bones from the nodes, for bones that aren't animated
+    pose rest_pose;
+
+    // World transform of the node the root bones are attached to
+    glm::mat4x3 root_transform{1.f};
+
+    std::size_t size() const { return parents.size(); }
+};
+
+// a * b, treating both as 4x4 matrices with the last row (0, 0, 0, 1)
+glm::mat4x3 compose(glm::mat4x3 const & a, glm::mat4x3 const & b);
+
+skeleton make_skeleton(gltf_model const & model, gltf_model::skin const & skin);
+
+// World transforms of all the bones in a single forward pass, together with the
+// skinning palette (world transform times inverse bind matrix) ready for upload
+// with glUniformMatrix4x3fv
+void evaluate(skeleton const & skeleton, pose const & local, std::vector<glm::mat4x3> & world, std::vector<glm::mat4x3> & palette);
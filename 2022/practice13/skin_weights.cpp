@@ -0,0 +1,107 @@
+#include "skin_weights.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+quantized_skin_weights process_skin_weights(skinned_mesh & mesh, skin_weight_settings const & settings)
+{
+    std::size_t const count = mesh.positions.size();
+    int const max_influences = std::clamp<int>(settings.max_influences, 1, 4);
+
+    quantized_skin_weights result;
+    result.joints.resize(count);
+    result.weights.resize(count);
+    result.influence_counts.resize(count);
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        // Largest weight first, ties broken by the joint index to stay deterministic
+        std::array<int, 4> order{0, 1, 2, 3};
+        std::sort(order.begin(), order.end(), [&](int a, int b)
+        {
+            if (mesh.weights[i][a] != mesh.weights[i][b])
+                return mesh.weights[i][a] > mesh.weights[i][b];
+            return mesh.joints[i][a] < mesh.joints[i][b];
+        });
+
+        std::array<std::uint16_t, 4> joints{0, 0, 0, 0};
+        std::array<float, 4> weights{0.f, 0.f, 0.f, 0.f};
+        float total = 0.f;
+        for (int j = 0; j < 4; ++j)
+        {
+            joints[j] = mesh.joints[i][order[j]];
+            weights[j] = std::max(0.f, mesh.weights[i][order[j]]);
+            total += weights[j];
+        }
+
+        // A vertex without weights follows its first joint
+        if (total <= 0.f)
+        {
+            weights = {1.f, 0.f, 0.f, 0.f};
+            total = 1.f;
+        }
+
+        int influences = 1;
+        while (influences < max_influences && weights[influences] / total >= settings.min_weight)
+            ++influences;
+
+        float kept = 0.f;
+        for (int j = 0; j < influences; ++j)
+            kept += weights[j];
+
+        // Largest remainder rounding: floor everything, then hand the missing
+        // units to the weights that lost the most
+        std::array<int, 4> units{0, 0, 0, 0};
+        std::array<float, 4> remainders{0.f, 0.f, 0.f, 0.f};
+        int assigned = 0;
+        for (int j = 0; j < influences; ++j)
+        {
+            float const exact = weights[j] / kept * 255.f;
+            units[j] = int(std::floor(exact));
+            remainders[j] = exact - units[j];
+            assigned += units[j];
+        }
+
+        for (; assigned < 255; ++assigned)
+        {
+            int best = 0;
+            for (int j = 1; j < influences; ++j)
+                if (remainders[j] > remainders[best])
+                    best = j;
+            ++units[best];
+            remainders[best] = -1.f;
+        }
+
+        // Weights that rounded down to nothing don't count as influences
+        while (influences > 1 && units[influences - 1] == 0)
+            --influences;
+
+        for (int j = 0; j < 4; ++j)
+        {
+            bool const used = j < influences;
+            result.joints[i][j] = used ? joints[j] : 0;
+            result.weights[i][j] = used ? units[j] : 0;
+
+            mesh.joints[i][j] = result.joints[i][j];
+            mesh.weights[i][j] = result.weights[i][j] / 255.f;
+        }
+        result.influence_counts[i] = influences;
+    }
+
+    // Stable grouping by the fast path each vertex can take
+    mesh.vertex_order.clear();
+    mesh.vertex_order.reserve(count);
+    for (int group = 0; group < 3; ++group)
+    {
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            int const influences = result.influence_counts[i];
+            int const vertex_group = influences <= 2 ? influences - 1 : 2;
+            if (vertex_group == group)
+                mesh.vertex_order.push_back(i);
+        }
+        mesh.influence_groups[group] = mesh.vertex_order.size();
+    }
+
+    return result;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "cpu_skinning.hpp"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+struct skin_weight_settings
+{
+    // Influences with a smaller normalized weight are dropped
+    float min_weight = 0.01f;
+    // 4 for glTF, 2 for the human.bin layout
+    unsigned int max_influences = 4;
+};
+
+// Weights ready for upload as GL_UNSIGNED_BYTE normalized attributes
+struct quantized_skin_weights
+{
+    std::vector<std::array<std::uint16_t, 4>> joints;
+    // The weights of each vertex sum to exactly 255
+    std::vector<std::array<std::uint8_t, 4>> weights;
+    // Number of non-zero weights of each vertex
+    std::vector<std::uint8_t> influence_counts;
+};
+
+// Sorts the influences of every vertex by decreasing weight, drops the small
+// ones (always keeping the largest), renormalizes the rest and quantizes them
+// to 8 bits, distributing the rounding so that they still sum to one. The
+// float weights of the mesh are replaced by the quantized ones, so that CPU
+// and GPU skinning agree, and the vertices are grouped by influence count
+// (see skinned_mesh::vertex_order).
+quantized_skin_weights process_skin_weights(skinned_mesh & mesh, skin_weight_settings const & settings = {});
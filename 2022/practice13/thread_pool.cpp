@@ -0,0 +1,77 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+thread_pool::thread_pool(std::size_t size)
+{
+    for (std::size_t i = 1; i < size; ++i)
+        threads.emplace_back([this]{ work(); });
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (auto & thread : threads)
+        thread.join();
+}
+
+void thread_pool::parallel_for(std::size_t count, std::size_t chunk, std::function<void(std::size_t, std::size_t)> const & job)
+{
+    chunk = std::max<std::size_t>(chunk, 1);
+
+    if (threads.empty() || count <= chunk)
+    {
+        for (std::size_t begin = 0; begin < count; begin += chunk)
+            job(begin, std::min(begin + chunk, count));
+        return;
+    }
+
+    {
+        std::lock_guard lock(mutex);
+        this->job = &job;
+        this->count = count;
+        this->chunk = chunk;
+        next = 0;
+        busy = threads.size();
+        ++generation;
+    }
+    wake.notify_all();
+
+    run_chunks();
+
+    std::unique_lock lock(mutex);
+    done.wait(lock, [this]{ return busy == 0; });
+    this->job = nullptr;
+}
+
+void thread_pool::work()
+{
+    std::uint64_t seen = 0;
+
+    std::unique_lock lock(mutex);
+    while (true)
+    {
+        wake.wait(lock, [&]{ return stopping || generation != seen; });
+        if (stopping)
+            return;
+        seen = generation;
+
+        lock.unlock();
+        run_chunks();
+        lock.lock();
+
+        if (--busy == 0)
+            done.notify_one();
+    }
+}
+
+void thread_pool::run_chunks()
+{
+    for (std::size_t begin; (begin = next.fetch_add(chunk)) < count;)
+        (*job)(begin, std::min(begin + chunk, count));
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads for data-parallel loops. The calling thread
+// takes part in the work, so a pool of size 1 has no workers at all.
+class thread_pool
+{
+public:
+    explicit thread_pool(std::size_t size = std::thread::hardware_concurrency());
+    ~thread_pool();
+
+    thread_pool(thread_pool const &) = delete;
+    thread_pool & operator = (thread_pool const &) = delete;
+
+    std::size_t size() const { return threads.size() + 1; }
+
+    // Calls job(begin, end) for consecutive ranges of at most chunk elements
+    // covering [0, count), returns when all of them are done. The ranges are
+    // handed out dynamically, so the job must not depend on which thread runs it.
+    void parallel_for(std::size_t count, std::size_t chunk, std::function<void(std::size_t, std::size_t)> const & job);
+
+private:
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    // Current loop, published under the mutex by bumping generation
+    std::function<void(std::size_t, std::size_t)> const * job = nullptr;
+    std::size_t count = 0;
+    std::size_t chunk = 1;
+    std::atomic<std::size_t> next{0};
+    std::uint64_t generation = 0;
+    std::size_t busy = 0;
+    bool stopping = false;
+
+    void work();
+    void run_chunks();
+};
@@ -0,0 +1,167 @@
+#include "vertex_animation.hpp"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+// Octahedral mapping of a unit vector to [-1, 1]^2
+static glm::vec2 octahedral_encode(glm::vec3 n)
+{
+    n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    glm::vec2 result(n.x, n.y);
+    if (n.z < 0.f)
+        result = (1.f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f);
+    return result;
+}
+
+static glm::vec3 octahedral_decode(glm::vec2 const & e)
+{
+    glm::vec3 n(e.x, e.y, 1.f - std::abs(e.x) - std::abs(e.y));
+    if (n.z < 0.f)
+    {
+        glm::vec2 const folded = (1.f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f);
+        n.x = folded.x;
+        n.y = folded.y;
+    }
+    return glm::normalize(n);
+}
+
+static std::uint16_t quantize(float value, float min, float extent)
+{
+    return extent > 0.f ? std::lround(glm::clamp((value - min) / extent, 0.f, 1.f) * 65535.f) : 0;
+}
+
+static std::array<std::uint16_t, 4> encode_texel(vertex_animation_texture const & texture, glm::vec3 const & position, glm::vec3 const & normal)
+{
+    glm::vec2 const octahedral = octahedral_encode(normal);
+    unsigned int const u = std::lround((octahedral.x * 0.5f + 0.5f) * 255.f);
+    unsigned int const v = std::lround((octahedral.y * 0.5f + 0.5f) * 255.f);
+
+    return {
+        quantize(position.x, texture.min.x, texture.extent.x),
+        quantize(position.y, texture.min.y, texture.extent.y),
+        quantize(position.z, texture.min.z, texture.extent.z),
+        std::uint16_t(u | (v << 8)),
+    };
+}
+
+glm::vec3 decode_position(vertex_animation_texture const & texture, std::array<std::uint16_t, 4> const & texel)
+{
+    return texture.min + texture.extent * glm::vec3(texel[0], texel[1], texel[2]) / 65535.f;
+}
+
+glm::vec3 decode_normal(std::array<std::uint16_t, 4> const & texel)
+{
+    glm::vec2 const octahedral(texel[3] & 0xFF, texel[3] >> 8);
+    return octahedral_decode(octahedral / 255.f * 2.f - 1.f);
+}
+
+vertex_animation_texture bake_vertex_animation(skinned_mesh const & mesh, skeleton const & skeleton, animation_clip const & clip, float frame_rate,
+    thread_pool & pool, vertex_animation_error * error)
+{
+    vertex_animation_texture result;
+    result.vertex_count = mesh.positions.size();
+    result.frame_count = std::size_t(std::ceil(clip.duration * frame_rate)) + 1;
+    result.frame_rate = frame_rate;
+
+    pose sampled = skeleton.rest_pose;
+    std::vector<std::size_t> cursors;
+    std::vector<glm::mat4x3> world, palette;
+
+    auto skin_at = [&](float time, skinned_vertices & vertices)
+    {
+        sample(clip, std::min(time, clip.duration), sampled, cursors);
+        evaluate(skeleton, sampled, world, palette);
+        skin(mesh, palette, skinning_mode::linear, vertices, pool);
+    };
+
+    // All the frames are skinned first, the quantization range covers all of them
+    std::vector<skinned_vertices> frames(result.frame_count);
+    bounding_box bounds;
+    for (std::size_t frame = 0; frame < result.frame_count; ++frame)
+    {
+        skin_at(frame / frame_rate, frames[frame]);
+        bounds.extend(frames[frame].bounds);
+    }
+
+    result.min = bounds.min;
+    result.extent = bounds.max - bounds.min;
+
+    bool const has_normals = !mesh.normals.empty();
+
+    result.texels.resize(result.frame_count * result.vertex_count);
+    for (std::size_t frame = 0; frame < result.frame_count; ++frame)
+        for (std::size_t i = 0; i < result.vertex_count; ++i)
+            result.texels[frame * result.vertex_count + i] = encode_texel(result, frames[frame].positions[i],
+                has_normals ? frames[frame].normals[i] : glm::vec3(0.f, 0.f, 1.f));
+
+    if (!error)
+        return result;
+
+    *error = {};
+
+    std::size_t position_count = 0;
+    for (std::size_t frame = 0; frame < result.frame_count; ++frame)
+        for (std::size_t i = 0; i < result.vertex_count; ++i)
+        {
+            auto const & texel = result.texels[frame * result.vertex_count + i];
+
+            float const position_error = glm::distance(decode_position(result, texel), frames[frame].positions[i]);
+            error->max_position_error = std::max(error->max_position_error, position_error);
+            error->mean_position_error += position_error;
+            ++position_count;
+
+            if (has_normals)
+            {
+                float const cosine = glm::clamp(glm::dot(decode_normal(texel), frames[frame].normals[i]), -1.f, 1.f);
+                float const normal_error = std::acos(cosine);
+                error->max_normal_error = std::max(error->max_normal_error, normal_error);
+                error->mean_normal_error += normal_error;
+            }
+        }
+
+    error->mean_position_error /= std::max<std::size_t>(position_count, 1);
+    error->mean_normal_error /= std::max<std::size_t>(has_normals ? position_count : 0, 1);
+
+    // What the runtime sees between two frames against the exact pose there
+    std::size_t interpolated_count = 0;
+    skinned_vertices halfway;
+    for (std::size_t frame = 0; frame + 1 < result.frame_count; ++frame)
+    {
+        float const time0 = frame / frame_rate;
+        float const time1 = std::min((frame + 1) / frame_rate, clip.duration);
+        skin_at((time0 + time1) * 0.5f, halfway);
+
+        for (std::size_t i = 0; i < result.vertex_count; ++i)
+        {
+            glm::vec3 const p0 = decode_position(result, result.texels[frame * result.vertex_count + i]);
+            glm::vec3 const p1 = decode_position(result, result.texels[(frame + 1) * result.vertex_count + i]);
+
+            float const interpolation_error = glm::distance((p0 + p1) * 0.5f, halfway.positions[i]);
+            error->max_interpolation_error = std::max(error->max_interpolation_error, interpolation_error);
+            error->mean_interpolation_error += interpolation_error;
+            ++interpolated_count;
+        }
+    }
+
+    error->mean_interpolation_error /= std::max<std::size_t>(interpolated_count, 1);
+
+    return result;
+}
+
+void save_vertex_animation(vertex_animation_texture const & texture, std::filesystem::path const & path)
+{
+    std::ofstream output(path, std::ios::binary);
+    if (!output)
+        throw std::runtime_error("Failed to write " + path.string());
+
+    std::uint32_t const sizes[2] = {std::uint32_t(texture.vertex_count), std::uint32_t(texture.frame_count)};
+    float const header[7] = {texture.frame_rate, texture.min.x, texture.min.y, texture.min.z, texture.extent.x, texture.extent.y, texture.extent.z};
+
+    output.write(reinterpret_cast<char const *>(sizes), sizeof(sizes));
+    output.write(reinterpret_cast<char const *>(header), sizeof(header));
+    output.write(reinterpret_cast<char const *>(texture.texels.data()), texture.texels.size() * sizeof(texture.texels[0]));
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "animation_clip.hpp"
+#include "cpu_skinning.hpp"
+#include "skeleton.hpp"
+#include "thread_pool.hpp"
+
+#include <glm/vec3.hpp>
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// A skinned mesh playing a clip, baked into an image with one row per frame
+// and one RGBA16 texel per vertex: xyz is the position quantized within the
+// bounds of the whole animation, w is the normal in octahedral encoding with
+// 8 bits per coordinate. Drawing it needs only the time of each instance.
+struct vertex_animation_texture
+{
+    std::size_t vertex_count = 0;
+    std::size_t frame_count = 0;
+    float frame_rate = 0.f;
+
+    glm::vec3 min{0.f};
+    glm::vec3 extent{0.f};
+
+    // texels[frame * vertex_count + vertex]
+    std::vector<std::array<std::uint16_t, 4>> texels;
+};
+
+// Differences between the exactly skinned vertices and the baked ones, at the
+// frames themselves and halfway between them with linear interpolation
+struct vertex_animation_error
+{
+    float max_position_error = 0.f;
+    float mean_position_error = 0.f;
+    float max_interpolation_error = 0.f;
+    float mean_interpolation_error = 0.f;
+    // In radians
+    float max_normal_error = 0.f;
+    float mean_normal_error = 0.f;
+};
+
+// Samples the clip at frame_rate from 0 to its duration inclusive, skinning
+// with linear blending
+vertex_animation_texture bake_vertex_animation(skinned_mesh const & mesh, skeleton const & skeleton, animation_clip const & clip, float frame_rate,
+    thread_pool & pool, vertex_animation_error * error = nullptr);
+
+glm::vec3 decode_position(vertex_animation_texture const & texture, std::array<std::uint16_t, 4> const & texel);
+glm::vec3 decode_normal(std::array<std::uint16_t, 4> const & texel);
+
+// Raw little-endian dump: a header with the sizes, frame rate and bounds,
+// followed by the texels row by row, ready for glTexImage2D with GL_RGBA16
+void save_vertex_animation(vertex_animation_texture const & texture, std::filesystem::path const & path);
@@ -0,0 +1,577 @@
+#include "convex_hull.hpp"
+
+#include <glm/geometric.hpp>
+#include <glm/mat3x3.hpp>
+#include <glm/matrix.hpp>
+
+#include <algorithm>
+#include <unordered_map>
+#include <stdexcept>
+#include <string>
+#include <limits>
+#include <cmath>
+
+static void add_unique_direction(std::vector<glm::vec3> & directions, glm::vec3 d)
+{
+	float const length = glm::length(d);
+	if (length == 0.f)
+		return;
+
+	d /= length;
+
+	// The separating axis test doesn't care about the sign of the axis
+	for (auto const & other : directions)
+		if (std::abs(glm::dot(other, d)) > 1.f - 1e-6f)
+			return;
+
+	directions.push_back(d);
+}
+
+// All the points lie in one plane (or on a line): the hull is a convex polygon
+static convex_hull flat_hull(std::vector<glm::vec3> const & points, glm::vec3 const & origin, glm::vec3 const & u, glm::vec3 const & v)
+{
+	struct point2
+	{
+		float x, y;
+		std::uint32_t index;
+	};
+
+	std::vector<point2> projected;
+	projected.reserve(points.size());
+	for (std::uint32_t i = 0; i < points.size(); ++i)
+		projected.push_back({glm::dot(points[i] - origin, u), glm::dot(points[i] - origin, v), i});
+
+	std::sort(projected.begin(), projected.end(), [](point2 const & p1, point2 const & p2){
+		return (p1.x < p2.x) || (p1.x == p2.x && p1.y < p2.y);
+	});
+
+	auto cross = [](point2 const & o, point2 const & a, point2 const & b)
+	{
+		return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+	};
+
+	// Andrew's monotone chain
+	std::vector<point2> polygon(2 * projected.size());
+	std::size_t size = 0;
+	for (std::size_t i = 0; i < projected.size(); ++i)
+	{
+		while (size >= 2 && cross(polygon[size - 2], polygon[size - 1], projected[i]) <= 0.f)
+			--size;
+		polygon[size++] = projected[i];
+	}
+	for (std::size_t i = projected.size() - 1, lower = size + 1; i-- > 0;)
+	{
+		while (size >= lower && cross(polygon[size - 2], polygon[size - 1], projected[i]) <= 0.f)
+			--size;
+		polygon[size++] = projected[i];
+	}
+	polygon.resize(size > 1 ? size - 1 : size);
+
+	convex_hull result;
+	for (auto const & p : polygon)
+		result.vertices.push_back(points[p.index]);
+
+	add_unique_direction(result.face_normals, glm::cross(u, v));
+	for (std::size_t i = 0; i < result.vertices.size(); ++i)
+	{
+		glm::vec3 const edge = result.vertices[(i + 1) % result.vertices.size()] - result.vertices[i];
+		add_unique_direction(result.edge_directions, edge);
+		add_unique_direction(result.face_normals, glm::cross(glm::cross(u, v), edge));
+	}
+
+	for (std::uint32_t i = 1; i + 1 < result.vertices.size(); ++i)
+		result.triangles.push_back({0, i, i + 1});
+
+	return result;
+}
+
+static std::uint64_t edge_key(std::uint32_t a, std::uint32_t b)
+{
+	return (std::uint64_t(a) << 32) | b;
+}
+
+// Unique face normals and edge directions for the separating axis test.
+// Normals are shared by coplanar triangles, and the edges between them
+// aren't real edges of the hull.
+static void compute_axes(convex_hull & hull)
+{
+	hull.face_normals.clear();
+	hull.edge_directions.clear();
+
+	std::vector<glm::vec3> triangle_normals;
+	std::unordered_map<std::uint64_t, std::size_t> edge_triangle;
+	for (std::size_t t = 0; t < hull.triangles.size(); ++t)
+	{
+		auto const & tri = hull.triangles[t];
+		triangle_normals.push_back(glm::normalize(glm::cross(hull.vertices[tri[1]] - hull.vertices[tri[0]], hull.vertices[tri[2]] - hull.vertices[tri[0]])));
+		add_unique_direction(hull.face_normals, triangle_normals.back());
+
+		for (int e = 0; e < 3; ++e)
+			edge_triangle[edge_key(tri[e], tri[(e + 1) % 3])] = t;
+	}
+
+	for (std::size_t t = 0; t < hull.triangles.size(); ++t)
+	{
+		auto const & tri = hull.triangles[t];
+		for (int e = 0; e < 3; ++e)
+		{
+			std::uint32_t const a = tri[e];
+			std::uint32_t const b = tri[(e + 1) % 3];
+			if (a > b)
+				continue;
+
+			auto twin = edge_triangle.find(edge_key(b, a));
+			if (twin != edge_triangle.end() && glm::dot(triangle_normals[t], triangle_normals[twin->second]) > 1.f - 1e-5f)
+				continue;
+
+			add_unique_direction(hull.edge_directions, hull.vertices[b] - hull.vertices[a]);
+		}
+	}
+}
+
+// With max_vertices != 0 the hull is built from at most that many
+// of the extreme points and doesn't contain the rest of the points
+static convex_hull quickhull(std::vector<glm::vec3> const & points, std::size_t max_vertices)
+{
+	if (points.empty())
+		return {};
+
+	glm::vec3 min = points[0];
+	glm::vec3 max = points[0];
+	for (auto const & p : points)
+	{
+		min = glm::min(min, p);
+		max = glm::max(max, p);
+	}
+
+	float const eps = 1e-5f * std::max(1e-6f, glm::length(max - min));
+
+	// Initial tetrahedron: the most distant pair of axis extremes, then the
+	// point farthest from their line, then the point farthest from that plane
+	std::array<std::uint32_t, 6> extremes = {0, 0, 0, 0, 0, 0};
+	for (std::uint32_t i = 0; i < points.size(); ++i)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			if (points[i][k] < points[extremes[2 * k]][k]) extremes[2 * k] = i;
+			if (points[i][k] > points[extremes[2 * k + 1]][k]) extremes[2 * k + 1] = i;
+		}
+	}
+
+	std::uint32_t i0 = extremes[0];
+	std::uint32_t i1 = extremes[1];
+	for (int k = 1; k < 3; ++k)
+	{
+		if (glm::distance(points[extremes[2 * k]], points[extremes[2 * k + 1]]) > glm::distance(points[i0], points[i1]))
+		{
+			i0 = extremes[2 * k];
+			i1 = extremes[2 * k + 1];
+		}
+	}
+
+	if (glm::distance(points[i0], points[i1]) <= eps)
+		return {{points[i0]}, {}, {}, {}};
+
+	glm::vec3 const line = glm::normalize(points[i1] - points[i0]);
+
+	std::uint32_t i2 = i0;
+	float best = 0.f;
+	for (std::uint32_t i = 0; i < points.size(); ++i)
+	{
+		float const d = glm::length(glm::cross(points[i] - points[i0], line));
+		if (d > best)
+		{
+			best = d;
+			i2 = i;
+		}
+	}
+
+	if (best <= eps)
+		return {{points[i0], points[i1]}, {}, {}, {line}};
+
+	glm::vec3 const plane = glm::normalize(glm::cross(points[i1] - points[i0], points[i2] - points[i0]));
+
+	std::uint32_t i3 = i0;
+	best = 0.f;
+	for (std::uint32_t i = 0; i < points.size(); ++i)
+	{
+		float const d = std::abs(glm::dot(points[i] - points[i0], plane));
+		if (d > best)
+		{
+			best = d;
+			i3 = i;
+		}
+	}
+
+	if (best <= eps)
+		return flat_hull(points, points[i0], line, glm::cross(plane, line));
+
+	struct face
+	{
+		std::array<std::uint32_t, 3> v;
+		glm::vec3 normal;
+		float distance;
+		std::vector<std::uint32_t> outside;
+		bool removed = false;
+	};
+
+	glm::vec3 const interior = (points[i0] + points[i1] + points[i2] + points[i3]) * 0.25f;
+
+	std::vector<face> faces;
+
+	auto add_face = [&](std::uint32_t a, std::uint32_t b, std::uint32_t c)
+	{
+		glm::vec3 n = glm::normalize(glm::cross(points[b] - points[a], points[c] - points[a]));
+		if (glm::dot(n, points[a] - interior) < 0.f)
+		{
+			std::swap(b, c);
+			n = -n;
+		}
+
+		face f;
+		f.v = {a, b, c};
+		f.normal = n;
+		f.distance = glm::dot(n, points[a]);
+		faces.push_back(std::move(f));
+	};
+
+	add_face(i0, i1, i2);
+	add_face(i0, i1, i3);
+	add_face(i0, i2, i3);
+	add_face(i1, i2, i3);
+
+	auto assign = [&](std::uint32_t i, std::size_t first_face)
+	{
+		for (std::size_t f = first_face; f < faces.size(); ++f)
+		{
+			if (faces[f].removed)
+				continue;
+
+			if (glm::dot(faces[f].normal, points[i]) - faces[f].distance > eps)
+			{
+				faces[f].outside.push_back(i);
+				return;
+			}
+		}
+	};
+
+	for (std::uint32_t i = 0; i < points.size(); ++i)
+		if (i != i0 && i != i1 && i != i2 && i != i3)
+			assign(i, 0);
+
+	std::size_t vertex_count = 4;
+	std::vector<std::uint32_t> unassigned;
+	std::unordered_map<std::uint64_t, int> edges;
+	std::vector<std::pair<std::uint32_t, std::uint32_t>> horizon;
+
+	for (std::size_t current = 0; current < faces.size(); ++current)
+	{
+		if (max_vertices != 0 && vertex_count >= max_vertices)
+			break;
+
+		if (faces[current].removed || faces[current].outside.empty())
+			continue;
+
+		std::uint32_t apex = faces[current].outside[0];
+		float apex_distance = -std::numeric_limits<float>::infinity();
+		for (auto i : faces[current].outside)
+		{
+			float const d = glm::dot(faces[current].normal, points[i]);
+			if (d > apex_distance)
+			{
+				apex_distance = d;
+				apex = i;
+			}
+		}
+
+		// Remove all faces visible from the apex and collect their outside points
+		edges.clear();
+		unassigned.clear();
+		for (auto & f : faces)
+		{
+			if (f.removed || glm::dot(f.normal, points[apex]) - f.distance <= eps)
+				continue;
+
+			f.removed = true;
+			for (int e = 0; e < 3; ++e)
+				++edges[edge_key(f.v[e], f.v[(e + 1) % 3])];
+			for (auto i : f.outside)
+				if (i != apex)
+					unassigned.push_back(i);
+			f.outside.clear();
+			f.outside.shrink_to_fit();
+		}
+
+		// The horizon consists of the removed edges that have no removed twin
+		horizon.clear();
+		for (auto const & edge : edges)
+		{
+			std::uint32_t const a = edge.first >> 32;
+			std::uint32_t const b = edge.first & 0xffffffffu;
+			if (!edges.contains(edge_key(b, a)))
+				horizon.emplace_back(a, b);
+		}
+
+		std::size_t const first_new = faces.size();
+		for (auto const & edge : horizon)
+			add_face(edge.first, edge.second, apex);
+
+		for (auto i : unassigned)
+			assign(i, first_new);
+
+		++vertex_count;
+	}
+
+	std::vector<std::uint32_t> remap(points.size(), std::uint32_t(-1));
+	convex_hull result;
+
+	for (auto const & f : faces)
+	{
+		if (f.removed)
+			continue;
+
+		std::array<std::uint32_t, 3> triangle;
+		for (int e = 0; e < 3; ++e)
+		{
+			if (remap[f.v[e]] == std::uint32_t(-1))
+			{
+				remap[f.v[e]] = result.vertices.size();
+				result.vertices.push_back(points[f.v[e]]);
+			}
+			triangle[e] = remap[f.v[e]];
+		}
+		result.triangles.push_back(triangle);
+	}
+
+	compute_axes(result);
+
+	return result;
+}
+
+static glm::vec3 center(convex_hull const & hull)
+{
+	glm::vec3 result(0.f);
+	for (auto const & v : hull.vertices)
+		result += v;
+	return result / float(hull.vertices.size());
+}
+
+static float volume(convex_hull const & hull)
+{
+	float result = 0.f;
+	for (auto const & t : hull.triangles)
+		result += glm::dot(hull.vertices[t[0]], glm::cross(hull.vertices[t[1]], hull.vertices[t[2]])) / 6.f;
+	return result;
+}
+
+// Scales the hull about its center until it contains all the points
+static convex_hull scale_to_enclose(convex_hull hull, std::vector<glm::vec3> const & points)
+{
+	glm::vec3 const c = center(hull);
+
+	float scale = 1.f;
+	for (auto const & t : hull.triangles)
+	{
+		glm::vec3 const n = glm::cross(hull.vertices[t[1]] - hull.vertices[t[0]], hull.vertices[t[2]] - hull.vertices[t[0]]);
+		float const face_distance = glm::dot(n, hull.vertices[t[0]] - c);
+		if (face_distance <= 0.f)
+			continue;
+
+		for (auto const & p : points)
+			scale = std::max(scale, glm::dot(n, p - c) / face_distance);
+	}
+
+	for (auto & v : hull.vertices)
+		v = c + (v - c) * scale;
+
+	return hull;
+}
+
+// Moves every face plane of the hull outwards until it touches the points, and
+// intersects the resulting half-spaces. The intersection is computed in the dual
+// space: each plane n.x = d maps to the point n / (d - n.c), and each face of the
+// hull of these points maps back to a vertex of the intersection.
+static convex_hull push_planes(convex_hull const & hull, std::vector<glm::vec3> const & points)
+{
+	static constexpr float inf = std::numeric_limits<float>::infinity();
+
+	glm::vec3 const c = center(hull);
+
+	std::vector<glm::vec3> dual;
+	for (auto const & n : hull.face_normals)
+	{
+		// face_normals are unsigned axes, so take both sides of each one
+		for (glm::vec3 const & d : {n, -n})
+		{
+			float max = -inf;
+			for (auto const & p : points)
+				max = std::max(max, glm::dot(d, p - c));
+
+			if (max > 0.f)
+				dual.push_back(d / max);
+		}
+	}
+
+	convex_hull const dual_hull = quickhull(dual, 0);
+
+	std::vector<glm::vec3> vertices;
+	for (auto const & t : dual_hull.triangles)
+	{
+		glm::vec3 const m = glm::normalize(glm::cross(dual_hull.vertices[t[1]] - dual_hull.vertices[t[0]], dual_hull.vertices[t[2]] - dual_hull.vertices[t[0]]));
+		float const e = glm::dot(m, dual_hull.vertices[t[0]]);
+		if (e > 0.f)
+			vertices.push_back(c + m / e);
+	}
+
+	return quickhull(vertices, 0);
+}
+
+convex_hull compute_convex_hull(std::vector<glm::vec3> const & points, std::size_t max_vertices)
+{
+	// Fewer vertices cannot enclose a volume, quickhull would return more than asked
+	if (max_vertices != 0 && max_vertices < 4)
+		throw std::runtime_error("Convex hull needs at least 4 vertices, got max_vertices = " + std::to_string(max_vertices));
+
+	convex_hull result = quickhull(points, 0);
+	if (max_vertices == 0 || result.vertices.size() <= max_vertices || result.triangles.empty())
+		return result;
+
+	result = scale_to_enclose(quickhull(points, max_vertices), points);
+
+	// Pushing the planes of a coarser hull out is usually much tighter than
+	// scaling, but creates new vertices, so try a few coarser hulls
+	auto try_candidate = [&](convex_hull candidate)
+	{
+		if (candidate.vertices.size() <= max_vertices && volume(candidate) < volume(result))
+			result = std::move(candidate);
+	};
+
+	for (std::size_t count = max_vertices; count >= 4; count = count * 3 / 4)
+		try_candidate(push_planes(quickhull(points, count), points));
+
+	if (max_vertices >= 8)
+		try_candidate(compute_kdop(points, 6));
+
+	return result;
+}
+
+static std::vector<glm::vec3> kdop_axes(int k)
+{
+	if (k != 6 && k != 14 && k != 18 && k != 26)
+		throw std::runtime_error("Unsupported k-DOP: k = " + std::to_string(k) + ", expected 6, 14, 18 or 26");
+
+	std::vector<glm::vec3> axes = {
+		{1.f, 0.f, 0.f},
+		{0.f, 1.f, 0.f},
+		{0.f, 0.f, 1.f},
+	};
+
+	if (k == 14 || k == 26)
+	{
+		axes.push_back({1.f, 1.f, 1.f});
+		axes.push_back({1.f, -1.f, 1.f});
+		axes.push_back({1.f, 1.f, -1.f});
+		axes.push_back({1.f, -1.f, -1.f});
+	}
+
+	if (k == 18 || k == 26)
+	{
+		axes.push_back({1.f, 1.f, 0.f});
+		axes.push_back({1.f, -1.f, 0.f});
+		axes.push_back({1.f, 0.f, 1.f});
+		axes.push_back({1.f, 0.f, -1.f});
+		axes.push_back({0.f, 1.f, 1.f});
+		axes.push_back({0.f, 1.f, -1.f});
+	}
+
+	for (auto & axis : axes)
+		axis = glm::normalize(axis);
+
+	return axes;
+}
+
+convex_hull compute_kdop(std::vector<glm::vec3> const & points, int k)
+{
+	static constexpr float inf = std::numeric_limits<float>::infinity();
+
+	if (points.empty())
+		return {};
+
+	auto const axes = kdop_axes(k);
+
+	// Each slab gives two planes n.p <= d, the lower one is stored with a negated normal
+	std::vector<glm::vec3> normals;
+	std::vector<float> distances;
+	for (auto const & axis : axes)
+	{
+		float min = inf;
+		float max = -inf;
+		for (auto const & p : points)
+		{
+			min = std::min(min, glm::dot(p, axis));
+			max = std::max(max, glm::dot(p, axis));
+		}
+
+		normals.push_back(axis);
+		distances.push_back(max);
+		normals.push_back(-axis);
+		distances.push_back(-min);
+	}
+
+	float scale = 0.f;
+	for (float d : distances)
+		scale = std::max(scale, std::abs(d));
+	float const eps = 1e-5f * std::max(scale, 1e-6f);
+
+	// The vertices of the polytope are the intersections of plane triples that satisfy all the planes
+	std::vector<glm::vec3> vertices;
+	for (std::size_t a = 0; a < normals.size(); ++a)
+	{
+		for (std::size_t b = a + 1; b < normals.size(); ++b)
+		{
+			for (std::size_t c = b + 1; c < normals.size(); ++c)
+			{
+				glm::mat3 m(normals[a], normals[b], normals[c]);
+				m = glm::transpose(m);
+
+				float const det = glm::determinant(m);
+				if (std::abs(det) < 1e-6f)
+					continue;
+
+				glm::vec3 const p = glm::inverse(m) * glm::vec3(distances[a], distances[b], distances[c]);
+
+				bool inside = true;
+				for (std::size_t i = 0; i < normals.size() && inside; ++i)
+					inside = glm::dot(normals[i], p) <= distances[i] + eps;
+
+				if (inside)
+					vertices.push_back(p);
+			}
+		}
+	}
+
+	return compute_convex_hull(vertices);
+}
+
+convex_hull transform(convex_hull const & hull, glm::mat4 const & model)
+{
+	glm::mat3 const linear(model);
+	glm::mat3 const normal_matrix = glm::transpose(glm::inverse(linear));
+
+	convex_hull result;
+	result.triangles = hull.triangles;
+
+	result.vertices.reserve(hull.vertices.size());
+	for (auto const & v : hull.vertices)
+		result.vertices.push_back(glm::vec3(model * glm::vec4(v, 1.f)));
+
+	result.face_normals.reserve(hull.face_normals.size());
+	for (auto const & n : hull.face_normals)
+		result.face_normals.push_back(normal_matrix * n);
+
+	result.edge_directions.reserve(hull.edge_directions.size());
+	for (auto const & e : hull.edge_directions)
+		result.edge_directions.push_back(linear * e);
+
+	return result;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+// A convex polytope in the form expected by intersect(): the vertices plus the
+// unique face normals and edge directions. The triangles are kept so that the
+// proxy can also be rendered, e.g. for occlusion queries.
+struct convex_hull
+{
+	std::vector<glm::vec3> vertices;
+	std::vector<std::array<std::uint32_t, 3>> triangles;
+
+	std::vector<glm::vec3> face_normals;
+	std::vector<glm::vec3> edge_directions;
+};
+
+// Quickhull. With max_vertices != 0 and a hull that has more vertices, a
+// simplified hull with at most max_vertices is returned instead: the faces of a
+// coarser hull are pushed out to enclose all the points, so the result is still
+// conservative. max_vertices between 1 and 3 throws.
+convex_hull compute_convex_hull(std::vector<glm::vec3> const & points, std::size_t max_vertices = 0);
+
+// Discrete oriented polytope: the intersection of k / 2 slabs along fixed
+// directions fitted to the points; k is one of 6, 14, 18 or 26, other values throw
+convex_hull compute_kdop(std::vector<glm::vec3> const & points, int k);
+
+// Hull in the model space -> hull in the world space, the transform is expected to be affine
+convex_hull transform(convex_hull const & hull, glm::mat4 const & model);
@@ -0,0 +1,522 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/geometric.hpp>
+
+#include <array>
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#include "aabb.hpp"
+#include "obb.hpp"
+#include "sphere.hpp"
+
+// The farthest point of the body along the direction. The generic version
+// works for anything exposing vertices, like the separating axis test does;
+// the overloads below are the closed-form fast paths.
+template <typename Body>
+glm::vec3 support(Body const & b, glm::vec3 const & d)
+{
+	glm::vec3 result = b.vertices[0];
+	float max = glm::dot(result, d);
+
+	for (auto const & p : b.vertices)
+	{
+		float v = glm::dot(p, d);
+		if (v > max)
+		{
+			max = v;
+			result = p;
+		}
+	}
+
+	return result;
+}
+
+inline glm::vec3 support(aabb const & b, glm::vec3 const & d)
+{
+	// vertices[0] is the minimal corner and vertices[7] is the maximal one
+	glm::vec3 const & min = b.vertices[0];
+	glm::vec3 const & max = b.vertices[7];
+
+	return {
+		(d.x > 0.f) ? max.x : min.x,
+		(d.y > 0.f) ? max.y : min.y,
+		(d.z > 0.f) ? max.z : min.z,
+	};
+}
+
+inline glm::vec3 support(obb const & b, glm::vec3 const & d)
+{
+	glm::vec3 result = b.center;
+	for (std::size_t i = 0; i < 3; ++i)
+		result += ((glm::dot(b.axes[i], d) > 0.f) ? 1.f : -1.f) * b.half_extents[i] * b.axes[i];
+	return result;
+}
+
+inline glm::vec3 support(sphere const & s, glm::vec3 const & d)
+{
+	float const length = glm::length(d);
+	if (length == 0.f)
+		return s.center;
+	return s.center + d * (s.radius / length);
+}
+
+// Support point of the Minkowski difference b1 - b2
+template <typename Body1, typename Body2>
+glm::vec3 support(Body1 const & b1, Body2 const & b2, glm::vec3 const & d)
+{
+	return support(b1, d) - support(b2, -d);
+}
+
+struct gjk_simplex
+{
+	std::array<glm::vec3, 4> points;
+	int size = 0;
+
+	void push(glm::vec3 const & p) { points[size++] = p; }
+};
+
+// Closest point of the simplex to the origin; the simplex is reduced
+// to the smallest sub-simplex that contains the closest point
+inline glm::vec3 closest_to_origin_segment(gjk_simplex & s)
+{
+	glm::vec3 const a = s.points[0];
+	glm::vec3 const b = s.points[1];
+	glm::vec3 const ab = b - a;
+
+	float const length2 = glm::dot(ab, ab);
+	float const t = (length2 > 0.f) ? glm::dot(-a, ab) / length2 : 0.f;
+
+	if (t <= 0.f)
+	{
+		s.size = 1;
+		return a;
+	}
+
+	if (t >= 1.f)
+	{
+		s.points[0] = b;
+		s.size = 1;
+		return b;
+	}
+
+	return a + t * ab;
+}
+
+inline glm::vec3 closest_to_origin_triangle(gjk_simplex & s)
+{
+	glm::vec3 const a = s.points[0];
+	glm::vec3 const b = s.points[1];
+	glm::vec3 const c = s.points[2];
+
+	glm::vec3 const ab = b - a;
+	glm::vec3 const ac = c - a;
+
+	float const d1 = glm::dot(ab, -a);
+	float const d2 = glm::dot(ac, -a);
+	if (d1 <= 0.f && d2 <= 0.f)
+	{
+		s.size = 1;
+		return a;
+	}
+
+	float const d3 = glm::dot(ab, -b);
+	float const d4 = glm::dot(ac, -b);
+	if (d3 >= 0.f && d4 <= d3)
+	{
+		s.points[0] = b;
+		s.size = 1;
+		return b;
+	}
+
+	float const vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f)
+	{
+		s.size = 2;
+		return a + ab * (d1 / (d1 - d3));
+	}
+
+	float const d5 = glm::dot(ab, -c);
+	float const d6 = glm::dot(ac, -c);
+	if (d6 >= 0.f && d5 <= d6)
+	{
+		s.points[0] = c;
+		s.size = 1;
+		return c;
+	}
+
+	float const vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f)
+	{
+		s.points[1] = c;
+		s.size = 2;
+		return a + ac * (d2 / (d2 - d6));
+	}
+
+	float const va = d3 * d6 - d5 * d4;
+	if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f)
+	{
+		s.points[0] = b;
+		s.points[1] = c;
+		s.size = 2;
+		return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+	}
+
+	float const denom = va + vb + vc;
+	if (denom == 0.f)
+	{
+		// Degenerate triangle, fall back to its longest edge
+		s.points[1] = (glm::dot(ab, ab) > glm::dot(ac, ac)) ? b : c;
+		s.size = 2;
+		return closest_to_origin_segment(s);
+	}
+
+	return a + ab * (vb / denom) + ac * (vc / denom);
+}
+
+inline glm::vec3 closest_to_origin_tetrahedron(gjk_simplex & s)
+{
+	static constexpr int faces[4][4] = {
+		{0, 1, 2, 3},
+		{0, 2, 3, 1},
+		{0, 3, 1, 2},
+		{1, 3, 2, 0},
+	};
+
+	bool inside = true;
+	float best_distance = std::numeric_limits<float>::infinity();
+	glm::vec3 best_point(0.f);
+	gjk_simplex best_simplex;
+
+	for (auto const & f : faces)
+	{
+		glm::vec3 const & a = s.points[f[0]];
+		glm::vec3 const n = glm::cross(s.points[f[1]] - a, s.points[f[2]] - a);
+
+		float const sign_origin = glm::dot(-a, n);
+		float const sign_opposite = glm::dot(s.points[f[3]] - a, n);
+
+		// Only faces that separate the origin from the opposite vertex matter
+		if (sign_origin * sign_opposite > 0.f)
+			continue;
+
+		inside = false;
+
+		gjk_simplex face;
+		face.push(s.points[f[0]]);
+		face.push(s.points[f[1]]);
+		face.push(s.points[f[2]]);
+
+		glm::vec3 const p = closest_to_origin_triangle(face);
+		float const distance = glm::dot(p, p);
+		if (distance < best_distance)
+		{
+			best_distance = distance;
+			best_point = p;
+			best_simplex = face;
+		}
+	}
+
+	if (inside)
+		return glm::vec3(0.f);
+
+	s = best_simplex;
+	return best_point;
+}
+
+inline glm::vec3 closest_to_origin(gjk_simplex & s)
+{
+	switch (s.size)
+	{
+	case 1: return s.points[0];
+	case 2: return closest_to_origin_segment(s);
+	case 3: return closest_to_origin_triangle(s);
+	default: return closest_to_origin_tetrahedron(s);
+	}
+}
+
+struct gjk_result
+{
+	bool intersect;
+
+	// Distance between the bodies, zero if they intersect
+	float distance;
+
+	// The simplex of the Minkowski difference that GJK stopped at,
+	// encloses the origin when the bodies intersect
+	gjk_simplex simplex;
+};
+
+// Gilbert-Johnson-Keerthi distance query, works on convex bodies
+template <typename Body1, typename Body2>
+gjk_result gjk(Body1 const & b1, Body2 const & b2, int max_iterations = 64)
+{
+	static constexpr float tolerance = 1e-6f;
+
+	gjk_simplex simplex;
+	glm::vec3 v = support(b1, b2, glm::vec3(1.f, 0.f, 0.f));
+	simplex.push(v);
+
+	for (int iteration = 0; iteration < max_iterations; ++iteration)
+	{
+		float const v2 = glm::dot(v, v);
+		if (v2 <= tolerance * tolerance)
+			return {true, 0.f, simplex};
+
+		glm::vec3 const w = support(b1, b2, -v);
+
+		// No progress towards the origin: v is the closest point
+		if (v2 - glm::dot(v, w) <= tolerance * v2)
+			return {false, std::sqrt(v2), simplex};
+
+		for (int i = 0; i < simplex.size; ++i)
+			if (glm::dot(w - simplex.points[i], w - simplex.points[i]) <= tolerance * tolerance)
+				return {false, std::sqrt(v2), simplex};
+
+		simplex.push(w);
+		v = closest_to_origin(simplex);
+
+		if (simplex.size == 4)
+			return {true, 0.f, simplex};
+	}
+
+	float const v2 = glm::dot(v, v);
+	return {v2 <= tolerance * tolerance, std::sqrt(v2), simplex};
+}
+
+template <typename Body1, typename Body2>
+float gjk_distance(Body1 const & b1, Body2 const & b2)
+{
+	return gjk(b1, b2).distance;
+}
+
+// Boolean query: stops as soon as a separating plane is found instead of
+// converging to the exact distance, which is what culling and overlap tests need
+template <typename Body1, typename Body2>
+bool gjk_intersect(Body1 const & b1, Body2 const & b2, int max_iterations = 64)
+{
+	static constexpr float tolerance = 1e-6f;
+
+	gjk_simplex simplex;
+	glm::vec3 v = support(b1, b2, glm::vec3(1.f, 0.f, 0.f));
+	simplex.push(v);
+
+	for (int iteration = 0; iteration < max_iterations; ++iteration)
+	{
+		if (glm::dot(v, v) <= tolerance * tolerance)
+			return true;
+
+		glm::vec3 const w = support(b1, b2, -v);
+
+		// The plane through w orthogonal to v separates the origin from the difference
+		if (glm::dot(v, w) > 0.f)
+			return false;
+
+		// Getting a point of the simplex again means no progress: for nearly
+		// touching bodies rounding hides the separating plane, but v is as
+		// close to the origin as it gets and is not the origin
+		for (int i = 0; i < simplex.size; ++i)
+			if (glm::dot(w - simplex.points[i], w - simplex.points[i]) <= tolerance * tolerance)
+				return false;
+
+		simplex.push(w);
+		v = closest_to_origin(simplex);
+
+		if (simplex.size == 4)
+			return true;
+	}
+
+	return glm::dot(v, v) <= tolerance * tolerance;
+}
+
+struct contact
+{
+	// Moving the second body by normal * depth separates the bodies
+	glm::vec3 normal;
+	float depth;
+};
+
+// Expands the GJK simplex to a tetrahedron enclosing the origin, which EPA starts from.
+// Returns false if the Minkowski difference is flat (touching contact).
+template <typename Body1, typename Body2>
+bool expand_simplex(Body1 const & b1, Body2 const & b2, gjk_simplex & s)
+{
+	static constexpr float tolerance = 1e-6f;
+
+	static const glm::vec3 axes[6] = {
+		{1.f, 0.f, 0.f}, {-1.f, 0.f, 0.f},
+		{0.f, 1.f, 0.f}, {0.f, -1.f, 0.f},
+		{0.f, 0.f, 1.f}, {0.f, 0.f, -1.f},
+	};
+
+	if (s.size == 1)
+	{
+		for (auto const & d : axes)
+		{
+			glm::vec3 const p = support(b1, b2, d);
+			if (glm::distance(p, s.points[0]) > tolerance)
+			{
+				s.push(p);
+				break;
+			}
+		}
+	}
+
+	if (s.size == 2)
+	{
+		glm::vec3 const line = glm::normalize(s.points[1] - s.points[0]);
+
+		glm::vec3 axis(0.f);
+		axis[(std::abs(line.x) < std::abs(line.y)) ? ((std::abs(line.x) < std::abs(line.z)) ? 0 : 2) : ((std::abs(line.y) < std::abs(line.z)) ? 1 : 2)] = 1.f;
+
+		glm::vec3 const u = glm::normalize(glm::cross(line, axis));
+		glm::vec3 const w = glm::cross(line, u);
+
+		for (int i = 0; i < 6; ++i)
+		{
+			float const angle = i * 3.14159265f / 3.f;
+			glm::vec3 const p = support(b1, b2, std::cos(angle) * u + std::sin(angle) * w);
+			if (glm::length(glm::cross(p - s.points[0], line)) > tolerance)
+			{
+				s.push(p);
+				break;
+			}
+		}
+	}
+
+	if (s.size == 3)
+	{
+		glm::vec3 const n = glm::cross(s.points[1] - s.points[0], s.points[2] - s.points[0]);
+		float const length = glm::length(n);
+
+		if (length > 0.f)
+		{
+			for (glm::vec3 const & d : {n, -n})
+			{
+				glm::vec3 const p = support(b1, b2, d);
+				if (std::abs(glm::dot(p - s.points[0], n)) > tolerance * length)
+				{
+					s.push(p);
+					break;
+				}
+			}
+		}
+	}
+
+	return s.size == 4;
+}
+
+// Expanding polytope algorithm: penetration depth and direction of intersecting bodies
+template <typename Body1, typename Body2>
+std::optional<contact> penetration(Body1 const & b1, Body2 const & b2, int max_iterations = 64)
+{
+	static constexpr float tolerance = 1e-5f;
+
+	auto result = gjk(b1, b2);
+	if (!result.intersect)
+		return std::nullopt;
+
+	if (!expand_simplex(b1, b2, result.simplex))
+		return contact{glm::vec3(0.f, 1.f, 0.f), 0.f};
+
+	std::vector<glm::vec3> vertices(result.simplex.points.begin(), result.simplex.points.end());
+
+	glm::vec3 const interior = (vertices[0] + vertices[1] + vertices[2] + vertices[3]) * 0.25f;
+
+	struct face
+	{
+		std::array<std::size_t, 3> v;
+		glm::vec3 normal;
+		float distance;
+	};
+
+	std::vector<face> faces;
+
+	// Returns false for a degenerate face
+	auto add_face = [&](std::size_t a, std::size_t b, std::size_t c)
+	{
+		glm::vec3 n = glm::cross(vertices[b] - vertices[a], vertices[c] - vertices[a]);
+		float const length = glm::length(n);
+		if (length == 0.f)
+			return false;
+
+		n /= length;
+
+		// Orient the face outwards
+		if (glm::dot(n, vertices[a] - interior) < 0.f)
+		{
+			std::swap(b, c);
+			n = -n;
+		}
+
+		faces.push_back({{a, b, c}, n, glm::dot(n, vertices[a])});
+		return true;
+	};
+
+	add_face(0, 1, 2);
+	add_face(0, 3, 1);
+	add_face(0, 2, 3);
+	add_face(1, 3, 2);
+
+	std::vector<std::pair<std::size_t, std::size_t>> horizon;
+
+	for (int iteration = 0; iteration < max_iterations && !faces.empty(); ++iteration)
+	{
+		std::size_t closest = 0;
+		for (std::size_t i = 1; i < faces.size(); ++i)
+			if (faces[i].distance < faces[closest].distance)
+				closest = i;
+
+		face const f = faces[closest];
+
+		glm::vec3 const p = support(b1, b2, f.normal);
+		if (glm::dot(p, f.normal) - f.distance <= tolerance)
+			return contact{f.normal, std::max(0.f, f.distance)};
+
+		// Remove the faces visible from the new point, keeping their outline.
+		// Faces nearly coplanar with the point stay: the difference of two boxes
+		// has large flat faces split into several triangles, and removing some of
+		// them because of rounding breaks the outline of the visible region
+		horizon.clear();
+		for (std::size_t i = 0; i < faces.size();)
+		{
+			if (glm::dot(faces[i].normal, p - vertices[faces[i].v[0]]) <= tolerance)
+			{
+				++i;
+				continue;
+			}
+
+			for (int e = 0; e < 3; ++e)
+			{
+				std::pair<std::size_t, std::size_t> edge{faces[i].v[e], faces[i].v[(e + 1) % 3]};
+
+				auto reverse = std::find(horizon.begin(), horizon.end(), std::make_pair(edge.second, edge.first));
+				if (reverse != horizon.end())
+					horizon.erase(reverse);
+				else
+					horizon.push_back(edge);
+			}
+
+			faces[i] = faces.back();
+			faces.pop_back();
+		}
+
+		vertices.push_back(p);
+		for (auto const & edge : horizon)
+			add_face(edge.first, edge.second, vertices.size() - 1);
+	}
+
+	if (faces.empty())
+		return contact{glm::vec3(0.f, 1.f, 0.f), 0.f};
+
+	std::size_t closest = 0;
+	for (std::size_t i = 1; i < faces.size(); ++i)
+		if (faces[i].distance < faces[closest].distance)
+			closest = i;
+
+	return contact{faces[closest].normal, std::max(0.f, faces[closest].distance)};
+}
@@ -1,66 +1,332 @@
 #include "gltf_loader.hpp"
+#include "mapped_file.hpp"
 
 #include <rapidjson/document.h>
-#include <rapidjson/istreamwrapper.h>
 
 #include <fstream>
 #include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <string_view>
 
-static unsigned int attribute_type_to_size(std::string const & type)
+static constexpr std::uint32_t glb_magic = 0x46546C67; // "glTF"
+static constexpr std::uint32_t glb_chunk_json = 0x4E4F534A; // "JSON"
+static constexpr std::uint32_t glb_chunk_bin = 0x004E4942; // "BIN\0"
+
+static unsigned int attribute_type_to_size(std::string_view type)
 {
     if (type == "SCALAR") return 1;
     if (type == "VEC2") return 2;
     if (type == "VEC3") return 3;
     if (type == "VEC4") return 4;
-    return 0;
+    if (type == "MAT2") return 4;
+    if (type == "MAT3") return 9;
+    if (type == "MAT4") return 16;
+    throw std::runtime_error("Unknown attribute type: " + std::string(type));
 }
 
-gltf_model load_gltf(std::filesystem::path const & path)
+static unsigned int component_size(unsigned int type)
 {
-    rapidjson::Document document;
+    switch (type)
+    {
+    case 0x1400: // GL_BYTE
+    case 0x1401: // GL_UNSIGNED_BYTE
+        return 1;
+    case 0x1402: // GL_SHORT
+    case 0x1403: // GL_UNSIGNED_SHORT
+        return 2;
+    case 0x1405: // GL_UNSIGNED_INT
+    case 0x1406: // GL_FLOAT
+        return 4;
+    }
+    throw std::runtime_error("Unknown component type: " + std::to_string(type));
+}
+
+template <typename T>
+static T read_value(char const * data)
+{
+    T result;
+    std::memcpy(&result, data, sizeof(result));
+    return result;
+}
+
+static float read_component(char const * data, unsigned int type, bool normalized)
+{
+    switch (type)
+    {
+    case 0x1400: return normalized ? std::max(read_value<std::int8_t>(data) / 127.f, -1.f) : read_value<std::int8_t>(data);
+    case 0x1401: return normalized ? read_value<std::uint8_t>(data) / 255.f : read_value<std::uint8_t>(data);
+    case 0x1402: return normalized ? std::max(read_value<std::int16_t>(data) / 32767.f, -1.f) : read_value<std::int16_t>(data);
+    case 0x1403: return normalized ? read_value<std::uint16_t>(data) / 65535.f : read_value<std::uint16_t>(data);
+    case 0x1405: return read_value<std::uint32_t>(data);
+    case 0x1406: return read_value<float>(data);
+    }
+    throw std::runtime_error("Unknown component type: " + std::to_string(type));
+}
 
+static std::uint32_t read_index(char const * data, unsigned int type)
+{
+    switch (type)
     {
+    case 0x1401: return read_value<std::uint8_t>(data);
+    case 0x1403: return read_value<std::uint16_t>(data);
+    case 0x1405: return read_value<std::uint32_t>(data);
+    }
+    throw std::runtime_error("Unknown index type: " + std::to_string(type));
+}
+
+static gltf_model::buffer_data load_file(std::filesystem::path const & path, gltf_buffer_mode mode)
+{
+    gltf_model::buffer_data result;
+
+    if (mode == gltf_buffer_mode::map)
+    {
+        auto file = std::make_shared<mapped_file>(path);
+        result.pointer = file->data();
+        result.length = file->size();
+        result.owner = std::move(file);
+    }
+    else
+    {
+        auto data = std::make_shared<std::vector<char>>(std::filesystem::file_size(path));
+
         std::ifstream input(path, std::ios::binary);
-        rapidjson::IStreamWrapper stream(input);
-        document.ParseStream(stream);
+        if (!input.read(data->data(), data->size()))
+            throw std::runtime_error("Failed to read " + path.string());
+
+        result.pointer = data->data();
+        result.length = data->size();
+        result.owner = std::move(data);
     }
 
+    return result;
+}
+
+static gltf_model::buffer_data subrange(gltf_model::buffer_data const & data, std::size_t offset, std::size_t length)
+{
+    if (offset > data.size() || length > data.size() - offset)
+        throw std::runtime_error("Data range is out of bounds");
+
+    return {data.owner, data.data() + offset, length};
+}
+
+gltf_model load_gltf(std::filesystem::path const & path, gltf_buffer_mode mode)
+{
+    auto const file = load_file(path, mode);
+
+    gltf_model::buffer_data json = file;
+    std::optional<gltf_model::buffer_data> binary_chunk;
+
+    // GLB: a 12-byte header followed by a JSON chunk and an optional binary chunk
+    if (file.size() >= 12 && read_value<std::uint32_t>(file.data()) == glb_magic)
+    {
+        if (read_value<std::uint32_t>(file.data() + 4) != 2)
+            throw std::runtime_error("Unsupported GLB version in " + path.string());
+
+        std::size_t const length = std::min<std::size_t>(read_value<std::uint32_t>(file.data() + 8), file.size());
+
+        for (std::size_t offset = 12; offset + 8 <= length;)
+        {
+            std::uint32_t const chunk_length = read_value<std::uint32_t>(file.data() + offset);
+            std::uint32_t const chunk_type = read_value<std::uint32_t>(file.data() + offset + 4);
+
+            auto const chunk = subrange(file, offset + 8, chunk_length);
+
+            if (chunk_type == glb_chunk_json)
+                json = chunk;
+            else if (chunk_type == glb_chunk_bin && !binary_chunk)
+                binary_chunk = chunk;
+
+            offset += 8 + chunk_length;
+        }
+    }
+
+    // The text is parsed in place: the DOM strings point into this copy
+    // instead of being allocated one by one
+    std::vector<char> json_text(json.data(), json.data() + json.size());
+    json_text.push_back('\0');
+
+    rapidjson::Document document;
+    document.ParseInsitu(json_text.data());
+    if (document.HasParseError())
+        throw std::runtime_error("Failed to parse " + path.string());
+
+    // Top-level arrays are looked up once, member lookups are linear in the number of members
+    auto top_level_array = [&](char const * name) -> rapidjson::Value const &
+    {
+        static rapidjson::Value const empty(rapidjson::kArrayType);
+        auto it = document.FindMember(name);
+        return it == document.MemberEnd() ? empty : it->value;
+    };
+
+    auto const buffer_views = top_level_array("bufferViews").GetArray();
+    auto const accessors = top_level_array("accessors").GetArray();
+    auto const textures = top_level_array("textures").GetArray();
+    auto const images = top_level_array("images").GetArray();
+    auto const materials = top_level_array("materials").GetArray();
+
+    auto const buffers = top_level_array("buffers").GetArray();
+    auto const meshes = top_level_array("meshes").GetArray();
+
+    auto get_uint = [](rapidjson::Value const & object, char const * name, unsigned int default_value)
+    {
+        auto it = object.FindMember(name);
+        return it == object.MemberEnd() ? default_value : it->value.GetUint();
+    };
+
+    auto get_string = [](rapidjson::Value const & object, char const * name) -> std::string
+    {
+        auto it = object.FindMember(name);
+        return it == object.MemberEnd() ? std::string() : std::string(it->value.GetString(), it->value.GetStringLength());
+    };
+
     gltf_model result;
 
+    for (auto const & buffer : buffers)
     {
-        auto buffers = document["buffers"].GetArray();
-        assert(buffers.Size() == 1);
+        gltf_model::buffer_data data;
+
+        if (buffer.HasMember("uri"))
+        {
+            std::string const buffer_uri = buffer["uri"].GetString();
+            if (buffer_uri.starts_with("data:"))
+                throw std::runtime_error("Embedded buffers are not supported");
 
-        auto const buffer_uri = buffers[0]["uri"].GetString();
+            data = load_file(path.parent_path() / buffer_uri, mode);
+        }
+        else
+        {
+            // A buffer without uri refers to the binary chunk of the GLB file
+            if (!binary_chunk)
+                throw std::runtime_error("Missing binary chunk in " + path.string());
 
-        auto const buffer_path = path.parent_path() / buffer_uri;
+            data = *binary_chunk;
+        }
 
-        result.buffer.resize(std::filesystem::file_size(buffer_path));
-        std::ifstream buffer(buffer_path, std::ios::binary);
-        buffer.read(result.buffer.data(), result.buffer.size());
+        data.length = std::min<std::size_t>(data.length, buffer["byteLength"].GetUint64());
+        result.buffers.push_back(std::move(data));
     }
 
     auto parse_buffer_view = [&](int index) -> gltf_model::buffer_view
     {
-        auto view = document["bufferViews"].GetArray()[index].GetObject();
-        return {view["byteOffset"].GetUint(), view["byteLength"].GetUint()};
+        auto view = buffer_views[index].GetObject();
+
+        gltf_model::buffer_view result_view;
+        result_view.buffer = view["buffer"].GetUint();
+        result_view.offset = get_uint(view, "byteOffset", 0);
+        result_view.size = view["byteLength"].GetUint();
+        result_view.stride = get_uint(view, "byteStride", 0);
+
+        if (result_view.buffer >= result.buffers.size() || result.buffers[result_view.buffer].size() < std::size_t(result_view.offset) + result_view.size)
+            throw std::runtime_error("Buffer view is out of bounds in " + path.string());
+
+        return result_view;
     };
 
-    auto parse_accessor = [&](int index) -> gltf_model::accessor
+    // All the accessors are resolved upfront. Sparse accessors and accessors
+    // without a buffer view are expanded into a separate buffer owned by
+    // the model, all the others point straight into the glTF buffers.
+    std::vector<gltf_model::accessor> parsed_accessors;
+    std::vector<char> expanded;
+
+    for (auto const & accessor : accessors)
     {
-        auto accessor = document["accessors"].GetArray()[index].GetObject();
-        return {
-            parse_buffer_view(accessor["bufferView"].GetInt()),
-            accessor["componentType"].GetUint(),
-            attribute_type_to_size(accessor["type"].GetString()),
-            accessor["count"].GetUint(),
-        };
+        auto & result_accessor = parsed_accessors.emplace_back();
+        result_accessor.type = accessor["componentType"].GetUint();
+        result_accessor.size = attribute_type_to_size(accessor["type"].GetString());
+        result_accessor.count = accessor["count"].GetUint();
+        result_accessor.normalized = accessor.HasMember("normalized") && accessor["normalized"].GetBool();
+
+        std::size_t const element_size = component_size(result_accessor.type) * result_accessor.size;
+
+        if (accessor.HasMember("bufferView"))
+        {
+            result_accessor.view = parse_buffer_view(accessor["bufferView"].GetInt());
+
+            unsigned int const offset = get_uint(accessor, "byteOffset", 0);
+            std::size_t const stride = result_accessor.view.stride ? result_accessor.view.stride : element_size;
+
+            if (result_accessor.count > 0 && std::size_t(offset) + (result_accessor.count - 1) * stride + element_size > result_accessor.view.size)
+                throw std::runtime_error("Accessor is out of bounds in " + path.string());
+
+            result_accessor.view.offset += offset;
+            result_accessor.view.size -= offset;
+
+            if (!accessor.HasMember("sparse"))
+                continue;
+        }
+
+        // Base values or zeros, with the sparse values written over them
+        std::size_t const offset = (expanded.size() + 3) & ~std::size_t(3);
+        expanded.resize(offset + result_accessor.count * element_size, 0);
+
+        if (accessor.HasMember("bufferView"))
+        {
+            std::size_t const stride = result_accessor.view.stride ? result_accessor.view.stride : element_size;
+            char const * data = result.buffers[result_accessor.view.buffer].data() + result_accessor.view.offset;
+
+            for (std::size_t i = 0; i < result_accessor.count; ++i)
+                std::memcpy(expanded.data() + offset + i * element_size, data + i * stride, element_size);
+        }
+
+        if (accessor.HasMember("sparse"))
+        {
+            auto const & sparse = accessor["sparse"];
+            unsigned int const count = sparse["count"].GetUint();
+
+            auto const & indices = sparse["indices"];
+            auto const & values = sparse["values"];
+
+            auto const indices_view = parse_buffer_view(indices["bufferView"].GetInt());
+            auto const values_view = parse_buffer_view(values["bufferView"].GetInt());
+
+            unsigned int const indices_type = indices["componentType"].GetUint();
+            unsigned int const indices_offset = get_uint(indices, "byteOffset", 0);
+            unsigned int const values_offset = get_uint(values, "byteOffset", 0);
+
+            if (std::size_t(indices_offset) + std::size_t(count) * component_size(indices_type) > indices_view.size
+                || std::size_t(values_offset) + count * element_size > values_view.size)
+                throw std::runtime_error("Sparse accessor is out of bounds in " + path.string());
+
+            char const * indices_data = result.buffers[indices_view.buffer].data() + indices_view.offset + indices_offset;
+            char const * values_data = result.buffers[values_view.buffer].data() + values_view.offset + values_offset;
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                std::uint32_t const index = read_index(indices_data + i * component_size(indices_type), indices_type);
+                if (index >= result_accessor.count)
+                    throw std::runtime_error("Sparse accessor is out of bounds in " + path.string());
+
+                std::memcpy(expanded.data() + offset + index * element_size, values_data + i * element_size, element_size);
+            }
+        }
+
+        result_accessor.view.buffer = buffers.Size();
+        result_accessor.view.offset = offset;
+        result_accessor.view.size = result_accessor.count * element_size;
+        result_accessor.view.stride = 0;
+    }
+
+    if (!expanded.empty())
+    {
+        auto data = std::make_shared<std::vector<char>>(std::move(expanded));
+        result.buffers.push_back({data, data->data(), data->size()});
+    }
+
+    auto optional_accessor = [&](rapidjson::Value const & object, char const * name) -> std::optional<gltf_model::accessor>
+    {
+        auto it = object.FindMember(name);
+        if (it == object.MemberEnd())
+            return std::nullopt;
+        return parsed_accessors[it->value.GetInt()];
     };
 
-    auto parse_texture = [&](int index) -> std::string
+    auto parse_texture = [&](int index) -> std::optional<std::string>
     {
-        auto const source_index = document["textures"].GetArray()[index]["source"].GetInt();
-        return document["images"].GetArray()[source_index]["uri"].GetString();
+        auto const source_index = textures[index]["source"].GetInt();
+        if (!images[source_index].HasMember("uri"))
+            return std::nullopt;
+        return images[source_index]["uri"].GetString();
     };
 
     auto parse_color = [&](auto const & array)
@@ -84,41 +350,86 @@ gltf_model load_gltf(std::filesystem::path const & path)
 
     auto parse_bounds = [&](int index)
     {
-        auto accessor = document["accessors"].GetArray()[index].GetObject();
+        auto accessor = accessors[index].GetObject();
         return std::make_pair(
             parse_vector(accessor["min"]),
             parse_vector(accessor["max"])
         );
     };
 
-    for (auto const & mesh : document["meshes"].GetArray())
+    auto parse_material = [&](rapidjson::Value const & primitive)
     {
-        auto & result_mesh = result.meshes.emplace_back();
-        result_mesh.name = mesh["name"].GetString();
+        gltf_model::material result_material{};
 
-        auto primitives = mesh["primitives"].GetArray();
-        assert(primitives.Size() == 1);
+        // The default material is plain white
+        if (!primitive.HasMember("material"))
+        {
+            result_material.color = glm::vec4(1.f);
+            return result_material;
+        }
 
-        auto const & attributes = primitives[0]["attributes"];
+        auto const & material = materials[primitive["material"].GetInt()];
 
-        result_mesh.indices = parse_accessor(primitives[0]["indices"].GetInt());
-        result_mesh.position = parse_accessor(attributes["POSITION"].GetInt());
-        result_mesh.normal = parse_accessor(attributes["NORMAL"].GetInt());
-        result_mesh.texcoord = parse_accessor(attributes["TEXCOORD_0"].GetInt());
+        result_material.two_sided = material.HasMember("doubleSided") && material["doubleSided"].GetBool();
+        result_material.transparent = material.HasMember("alphaMode") && (material["alphaMode"].GetString() == std::string("BLEND"));
 
-        std::tie(result_mesh.min, result_mesh.max) = parse_bounds(attributes["POSITION"].GetInt());
+        if (material.HasMember("pbrMetallicRoughness"))
+        {
+            auto const & pbr = material["pbrMetallicRoughness"];
+            if (pbr.HasMember("baseColorTexture"))
+                result_material.texture_path = parse_texture(pbr["baseColorTexture"]["index"].GetInt());
+            if (!result_material.texture_path && pbr.HasMember("baseColorFactor"))
+                result_material.color = parse_color(pbr["baseColorFactor"].GetArray());
+        }
 
-        auto const & material = document["materials"].GetArray()[primitives[0]["material"].GetInt()];
+        // Images embedded into buffers aren't supported, these fall back to the default color too
+        if (!result_material.texture_path && !result_material.color)
+            result_material.color = glm::vec4(1.f);
 
-        result_mesh.material.two_sided = material.HasMember("doubleSided") && material["doubleSided"].GetBool();
-        result_mesh.material.transparent = material.HasMember("alphaMode") && (material["alphaMode"].GetString() == std::string("BLEND"));
+        return result_material;
+    };
 
-        auto const & pbr = material["pbrMetallicRoughness"];
-        if (pbr.HasMember("baseColorTexture"))
-            result_mesh.material.texture_path = parse_texture(pbr["baseColorTexture"]["index"].GetInt());
-        else if (pbr.HasMember("baseColorFactor"))
-            result_mesh.material.color = parse_color(pbr["baseColorFactor"].GetArray());
+    // Each primitive becomes a separate mesh
+    for (auto const & mesh : meshes)
+    {
+        for (auto const & primitive : mesh["primitives"].GetArray())
+        {
+            auto & result_mesh = result.meshes.emplace_back();
+            result_mesh.name = get_string(mesh, "name");
+            result_mesh.mode = get_uint(primitive, "mode", 4);
+
+            auto const & attributes = primitive["attributes"];
+
+            result_mesh.indices = optional_accessor(primitive, "indices");
+            result_mesh.position = parsed_accessors[attributes["POSITION"].GetInt()];
+            result_mesh.normal = optional_accessor(attributes, "NORMAL");
+            result_mesh.texcoord = optional_accessor(attributes, "TEXCOORD_0");
+
+            std::tie(result_mesh.min, result_mesh.max) = parse_bounds(attributes["POSITION"].GetInt());
+
+            result_mesh.material = parse_material(primitive);
+        }
     }
 
     return result;
 }
+
+void read_accessor(gltf_model const & model, gltf_model::accessor const & accessor, float * output)
+{
+    unsigned int const component = component_size(accessor.type);
+    std::size_t const element_size = component * accessor.size;
+    std::size_t const stride = accessor.view.stride ? accessor.view.stride : element_size;
+
+    char const * data = model.buffers[accessor.view.buffer].data() + accessor.view.offset;
+
+    // Tightly packed floats are the common case
+    if (accessor.type == 0x1406 && stride == element_size) // GL_FLOAT
+    {
+        std::memcpy(output, data, accessor.count * element_size);
+        return;
+    }
+
+    for (std::size_t i = 0; i < accessor.count; ++i)
+        for (std::size_t c = 0; c < accessor.size; ++c)
+            *output++ = read_component(data + i * stride + c * component, accessor.type, accessor.normalized);
+}
@@ -1,11 +1,13 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
 #include <vector>
 #include <string>
 #include <optional>
 #include <unordered_map>
 #include <algorithm>
+#include <cassert>
 
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
@@ -16,8 +18,13 @@ struct gltf_model
 {
     struct buffer_view
     {
-        unsigned int offset;
-        unsigned int size;
+        // Index into buffers
+        unsigned int buffer = 0;
+        // Offset of the first element, the accessor offset included
+        unsigned int offset = 0;
+        unsigned int size = 0;
+        // Zero means tightly packed, like in OpenGL
+        unsigned int stride = 0;
     };
 
     struct accessor
@@ -26,6 +33,7 @@ struct gltf_model
         unsigned int type;
         unsigned int size;
         unsigned int count;
+        bool normalized = false;
     };
 
     struct material
@@ -36,23 +44,65 @@ struct gltf_model
         std::optional<glm::vec4> color;
     };
 
+    // One primitive of a glTF mesh
     struct mesh
     {
         std::string name;
         struct material material;
 
-        accessor indices;
+        // GL_TRIANGLES, GL_LINES etc, the values match
+        unsigned int mode = 4;
+
+        // Non-indexed if missing
+        std::optional<accessor> indices;
 
         accessor position;
-        accessor normal;
-        accessor texcoord;
+        std::optional<accessor> normal;
+        std::optional<accessor> texcoord;
 
         glm::vec3 min;
         glm::vec3 max;
     };
 
-    std::vector<char> buffer;
+    // Binary data of a buffer: either a copy of the file in memory or a
+    // range of the mapped file, kept alive by the owner
+    struct buffer_data
+    {
+        std::shared_ptr<void const> owner;
+        char const * pointer = nullptr;
+        std::size_t length = 0;
+
+        char const * data() const { return pointer; }
+        std::size_t size() const { return length; }
+    };
+
+    // The glTF buffers as they are in the files, followed by
+    // a buffer with the sparse accessors expanded if there are any
+    std::vector<buffer_data> buffers;
     std::vector<mesh> meshes;
 };
 
-gltf_model load_gltf(std::filesystem::path const & path);
+enum class gltf_buffer_mode
+{
+    // Read the files into memory
+    read,
+    // Map the files into memory, so that the pages are only loaded on access
+    map,
+};
+
+// Loads both .gltf with external buffers and binary .glb files
+gltf_model load_gltf(std::filesystem::path const & path, gltf_buffer_mode mode = gltf_buffer_mode::map);
+
+// Converts the elements of an accessor to floats, taking care of the stride and
+// the normalized integer types; the output should hold count * size floats
+void read_accessor(gltf_model const & model, gltf_model::accessor const & accessor, float * output);
+
+template <typename T>
+std::vector<T> read_accessor(gltf_model const & model, gltf_model::accessor const & accessor)
+{
+    assert(sizeof(T) == accessor.size * sizeof(float));
+
+    std::vector<T> result(accessor.count);
+    read_accessor(model, accessor, reinterpret_cast<float *>(result.data()));
+    return result;
+}
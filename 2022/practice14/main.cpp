@@ -16,6 +16,7 @@
 #include <random>
 #include <map>
 #include <cmath>
+#include <algorithm>
 
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
@@ -30,6 +31,10 @@
 #include "aabb.hpp"
 #include "frustum.hpp"
 #include "intersect.hpp"
+#include "gjk.hpp"
+#include "obb.hpp"
+#include "sphere.hpp"
+#include "sweep_and_prune.hpp"
 
 std::string to_string(std::string_view str)
 {
@@ -130,8 +135,239 @@ GLuint create_program(Shaders ... shaders)
     return result;
 }
 
-int main() try
+// Headless: many bunnies tumbling inside a box. Their world boxes go through
+// the sweep-and-prune broadphase and the candidate pairs through the separating
+// axis test; the result is checked against testing every pair
+void run_overlap_benchmark()
 {
+    auto const input_model = load_gltf(std::string(PROJECT_ROOT) + "/bunny/bunny.gltf");
+    obb const mesh_box = compute_obb(read_accessor<glm::vec3>(input_model, input_model.meshes[0].position));
+
+    std::size_t const body_count = 4096;
+    int const frame_count = 100;
+    float const dt = 1.f / 60.f;
+    float const world_size = 32.f;
+
+    struct body
+    {
+        glm::vec3 position;
+        glm::vec3 velocity;
+        glm::vec3 rotation_axis;
+        float angular_velocity;
+    };
+
+    std::default_random_engine rng{42};
+    std::uniform_real_distribution<float> unit{-1.f, 1.f};
+
+    std::vector<body> bodies(body_count);
+    for (auto & b : bodies)
+    {
+        b.position = (glm::vec3(unit(rng), unit(rng), unit(rng)) * 0.5f + 0.5f) * world_size;
+        b.velocity = glm::vec3(unit(rng), unit(rng), unit(rng)) * 2.f;
+        b.rotation_axis = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + glm::vec3(0.f, 0.f, 1e-3f));
+        b.angular_velocity = unit(rng) * 3.f;
+    }
+
+    auto world_box = [&](body const & b, float time)
+    {
+        glm::mat4 model = glm::translate(glm::mat4(1.f), b.position);
+        model = glm::rotate(model, b.angular_velocity * time, b.rotation_axis);
+        return transform(mesh_box, model);
+    };
+
+    auto bounds = [](obb const & box)
+    {
+        glm::vec3 min = box.vertices[0];
+        glm::vec3 max = box.vertices[0];
+        for (auto const & v : box.vertices)
+        {
+            min = glm::min(min, v);
+            max = glm::max(max, v);
+        }
+        return std::make_pair(min, max);
+    };
+
+    sweep_and_prune broadphase;
+    std::vector<obb> boxes;
+    for (auto const & b : bodies)
+    {
+        boxes.push_back(world_box(b, 0.f));
+        auto const [min, max] = bounds(boxes.back());
+        broadphase.add(min, max);
+    }
+    broadphase.find_pairs();
+
+    float broadphase_ms = 0.f;
+    float narrowphase_ms = 0.f;
+    std::size_t candidate_count = 0;
+    std::size_t overlap_count = 0;
+
+    float time = 0.f;
+    for (int frame = 0; frame < frame_count; ++frame)
+    {
+        time += dt;
+
+        for (std::size_t i = 0; i < body_count; ++i)
+        {
+            auto & b = bodies[i];
+            b.position += b.velocity * dt;
+            for (int axis = 0; axis < 3; ++axis)
+                if ((b.position[axis] < 0.f && b.velocity[axis] < 0.f) || (b.position[axis] > world_size && b.velocity[axis] > 0.f))
+                    b.velocity[axis] = -b.velocity[axis];
+
+            boxes[i] = world_box(b, time);
+            auto const [min, max] = bounds(boxes[i]);
+            broadphase.update(i, min, max);
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        auto const & pairs = broadphase.find_pairs();
+        auto middle = std::chrono::high_resolution_clock::now();
+
+        overlap_count = 0;
+        for (auto const & [i, j] : pairs)
+            if (intersect(boxes[i], boxes[j]))
+                ++overlap_count;
+        auto end = std::chrono::high_resolution_clock::now();
+
+        candidate_count = pairs.size();
+        broadphase_ms += std::chrono::duration_cast<std::chrono::duration<float, std::milli>>(middle - start).count();
+        narrowphase_ms += std::chrono::duration_cast<std::chrono::duration<float, std::milli>>(end - middle).count();
+    }
+
+    std::cout << body_count << " bodies: broadphase " << (broadphase_ms / frame_count) << " ms, narrowphase "
+        << (narrowphase_ms / frame_count) << " ms per frame" << std::endl;
+    std::cout << "    last frame: " << candidate_count << " candidate pairs, " << overlap_count << " overlapping" << std::endl;
+
+    // Every pair of the last frame, with the cheap box test first
+    auto start = std::chrono::high_resolution_clock::now();
+    std::size_t expected_count = 0;
+    for (std::size_t i = 0; i < body_count; ++i)
+    {
+        auto const [min1, max1] = bounds(boxes[i]);
+        for (std::size_t j = i + 1; j < body_count; ++j)
+        {
+            auto const [min2, max2] = bounds(boxes[j]);
+            if (glm::all(glm::lessThanEqual(min1, max2)) && glm::all(glm::lessThanEqual(min2, max1)) && intersect(boxes[i], boxes[j]))
+                ++expected_count;
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    std::cout << "    all pairs: " << std::chrono::duration_cast<std::chrono::duration<float, std::milli>>(end - start).count()
+        << " ms, " << expected_count << " overlapping, results " << ((expected_count == overlap_count) ? "match" : "differ") << std::endl;
+}
+
+// Headless: the separating axis test against GJK on the same pairs of bunny
+// boxes, and of view frustums and boxes, reporting the cost per test and how
+// often the two disagree (only expected for touching bodies)
+void run_narrowphase_benchmark()
+{
+    auto const input_model = load_gltf(std::string(PROJECT_ROOT) + "/bunny/bunny.gltf");
+    obb const mesh_box = compute_obb(read_accessor<glm::vec3>(input_model, input_model.meshes[0].position));
+
+    std::default_random_engine rng{42};
+    std::uniform_real_distribution<float> unit{-1.f, 1.f};
+
+    auto random_axis = [&]
+    {
+        return glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + glm::vec3(0.f, 0.f, 1e-3f));
+    };
+
+    auto random_box = [&](float spread)
+    {
+        glm::mat4 model = glm::translate(glm::mat4(1.f), glm::vec3(unit(rng), unit(rng), unit(rng)) * spread);
+        model = glm::rotate(model, unit(rng) * glm::pi<float>(), random_axis());
+        return transform(mesh_box, model);
+    };
+
+    auto measure = [](char const * name, auto const & first, auto const & second)
+    {
+        std::size_t const count = first.size();
+
+        auto run = [&](auto test)
+        {
+            std::vector<char> result(count);
+            auto start = std::chrono::high_resolution_clock::now();
+            for (std::size_t i = 0; i < count; ++i)
+                result[i] = test(first[i], second[i]);
+            auto end = std::chrono::high_resolution_clock::now();
+
+            float const ns = std::chrono::duration_cast<std::chrono::duration<float, std::nano>>(end - start).count();
+            return std::make_pair(result, ns / count);
+        };
+
+        auto const [sat, sat_ns] = run([](auto const & b1, auto const & b2){ return intersect(b1, b2); });
+        auto const [gjk, gjk_ns] = run([](auto const & b1, auto const & b2){ return gjk_intersect(b1, b2); });
+
+        std::size_t overlap_count = 0;
+        std::size_t disagreement_count = 0;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            overlap_count += sat[i];
+            disagreement_count += (sat[i] != gjk[i]);
+        }
+
+        std::cout << name << ": SAT " << sat_ns << " ns, GJK " << gjk_ns << " ns per test, "
+            << overlap_count << " of " << count << " overlapping, " << disagreement_count << " disagreements" << std::endl;
+
+        return sat;
+    };
+
+    std::size_t const pair_count = 100000;
+
+    std::vector<obb> first;
+    std::vector<obb> second;
+    for (std::size_t i = 0; i < pair_count; ++i)
+    {
+        first.push_back(random_box(1.f));
+        second.push_back(random_box(1.f));
+    }
+
+    auto const overlapping = measure("box vs box", first, second);
+
+    // Penetration depth is only asked for pairs that are known to overlap
+    std::size_t contact_count = 0;
+    float max_depth = 0.f;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (std::size_t i = 0; i < pair_count; ++i)
+    {
+        if (!overlapping[i])
+            continue;
+
+        if (auto const c = penetration(first[i], second[i]))
+        {
+            ++contact_count;
+            max_depth = std::max(max_depth, c->depth);
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    float const ns = std::chrono::duration_cast<std::chrono::duration<float, std::nano>>(end - start).count();
+    std::cout << "    EPA: " << (ns / std::max<std::size_t>(contact_count, 1)) << " ns per contact, max depth " << max_depth << std::endl;
+
+    std::vector<frustum> frustums;
+    std::vector<obb> boxes;
+    glm::mat4 const projection = glm::perspective(glm::pi<float>() / 2.f, 4.f / 3.f, 0.1f, 10.f);
+    for (std::size_t i = 0; i < pair_count; ++i)
+    {
+        glm::mat4 const view = glm::lookAt(glm::vec3(unit(rng), unit(rng), unit(rng)) * 10.f, glm::vec3(0.f), random_axis());
+        frustums.emplace_back(projection * view);
+        boxes.push_back(random_box(10.f));
+    }
+
+    measure("frustum vs box", frustums, boxes);
+}
+
+int main(int argc, char ** argv) try
+{
+    if (argc > 1 && std::string_view(argv[1]) == "--benchmark")
+    {
+        run_overlap_benchmark();
+        run_narrowphase_benchmark();
+        return 0;
+    }
+
     if (SDL_Init(SDL_INIT_VIDEO) != 0)
         sdl2_fail("SDL_Init: ");
 
@@ -185,10 +421,14 @@ int main() try
     const std::string model_path = project_root + "/bunny/bunny.gltf";
 
     auto const input_model = load_gltf(model_path);
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, input_model.buffer.size(), input_model.buffer.data(), GL_STATIC_DRAW);
+
+    std::vector<GLuint> vbos(input_model.buffers.size());
+    glGenBuffers(vbos.size(), vbos.data());
+    for (std::size_t i = 0; i < vbos.size(); ++i)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, vbos[i]);
+        glBufferData(GL_ARRAY_BUFFER, input_model.buffers[i].size(), input_model.buffers[i].data(), GL_STATIC_DRAW);
+    }
 
     std::vector<GLuint> vaos;
     for (int i = 0; i < input_model.meshes.size(); ++i)
@@ -197,15 +437,19 @@ int main() try
         glGenVertexArrays(1, &vao);
         glBindVertexArray(vao);
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo);
+        if (input_model.meshes[i].indices)
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbos[input_model.meshes[i].indices->view.buffer]);
 
-        auto setup_attribute = [](int index, gltf_model::accessor const & accessor)
+        auto setup_attribute = [&](int index, std::optional<gltf_model::accessor> const & accessor)
         {
+            if (!accessor)
+                return;
+
+            glBindBuffer(GL_ARRAY_BUFFER, vbos[accessor->view.buffer]);
             glEnableVertexAttribArray(index);
-            glVertexAttribPointer(index, accessor.size, accessor.type, GL_FALSE, 0, reinterpret_cast<void *>(accessor.view.offset));
+            glVertexAttribPointer(index, accessor->size, accessor->type, accessor->normalized, accessor->view.stride, reinterpret_cast<void *>(accessor->view.offset));
         };
 
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
         setup_attribute(0, input_model.meshes[i].position);
         setup_attribute(1, input_model.meshes[i].normal);
         setup_attribute(2, input_model.meshes[i].texcoord);
@@ -213,6 +457,16 @@ int main() try
         vaos.push_back(vao);
     }
 
+    std::vector<obb> mesh_boxes;
+    std::vector<sphere> mesh_spheres;
+    for (auto const & mesh : input_model.meshes)
+    {
+        auto const positions = read_accessor<glm::vec3>(input_model, mesh.position);
+
+        mesh_boxes.push_back(compute_obb(positions));
+        mesh_spheres.push_back(compute_bounding_sphere(positions));
+    }
+
     GLuint texture;
     {
         auto const & mesh = input_model.meshes[0];
@@ -336,10 +590,23 @@ int main() try
 
         glBindTexture(GL_TEXTURE_2D, texture);
 
+        frustum const view_frustum(projection * view);
+
         {
             auto const & mesh = input_model.meshes[0];
-            glBindVertexArray(vaos[0]);
-            glDrawElements(GL_TRIANGLES, mesh.indices.count, mesh.indices.type, reinterpret_cast<void *>(mesh.indices.view.offset));
+
+            // The sphere test is cheaper, the box test is tighter
+            bool const visible = intersect(view_frustum, transform(mesh_spheres[0], model))
+                && intersect(view_frustum, transform(mesh_boxes[0], model));
+
+            if (visible)
+            {
+                glBindVertexArray(vaos[0]);
+                if (mesh.indices)
+                    glDrawElements(mesh.mode, mesh.indices->count, mesh.indices->type, reinterpret_cast<void *>(mesh.indices->view.offset));
+                else
+                    glDrawArrays(mesh.mode, 0, mesh.position.count);
+            }
         }
 
         SDL_GL_SwapWindow(window);
@@ -0,0 +1,202 @@
+#include "obb.hpp"
+
+#include <glm/geometric.hpp>
+#include <glm/mat3x3.hpp>
+#include <glm/ext/scalar_constants.hpp>
+
+#include <cmath>
+#include <limits>
+
+obb::obb(glm::vec3 const & center, std::array<glm::vec3, 3> const & axes, glm::vec3 const & half_extents)
+	: center(center)
+	, axes(axes)
+	, half_extents(half_extents)
+{
+	for (std::size_t i = 0; i < 8; ++i)
+	{
+		vertices[i] = center;
+		vertices[i] += ((i & 1) ? 1.f : -1.f) * half_extents.x * axes[0];
+		vertices[i] += ((i & 2) ? 1.f : -1.f) * half_extents.y * axes[1];
+		vertices[i] += ((i & 4) ? 1.f : -1.f) * half_extents.z * axes[2];
+	}
+
+	// Computed from the edges rather than copied from the axes, so that the
+	// box stays correct after a non-uniform scale makes the axes non-orthogonal
+	face_normals = {
+		glm::cross(axes[1], axes[2]),
+		glm::cross(axes[2], axes[0]),
+		glm::cross(axes[0], axes[1]),
+	};
+
+	edge_directions = axes;
+}
+
+float obb::volume() const
+{
+	return 8.f * half_extents.x * half_extents.y * half_extents.z * std::abs(glm::dot(axes[0], face_normals[0]));
+}
+
+obb transform(obb const & box, glm::mat4 const & model)
+{
+	glm::vec3 center = glm::vec3(model * glm::vec4(box.center, 1.f));
+
+	std::array<glm::vec3, 3> axes;
+	glm::vec3 half_extents;
+	for (std::size_t i = 0; i < 3; ++i)
+	{
+		glm::vec3 axis = glm::vec3(model * glm::vec4(box.axes[i], 0.f));
+		float const length = glm::length(axis);
+		axes[i] = axis / length;
+		half_extents[i] = box.half_extents[i] * length;
+	}
+
+	return obb(center, axes, half_extents);
+}
+
+// Jacobi eigenvalue iteration for a symmetric matrix, returns the eigenvectors
+static std::array<glm::vec3, 3> eigenvectors(glm::mat3 a)
+{
+	glm::mat3 v(1.f);
+
+	for (int sweep = 0; sweep < 16; ++sweep)
+	{
+		float off_diagonal = std::abs(a[0][1]) + std::abs(a[0][2]) + std::abs(a[1][2]);
+		if (off_diagonal < 1e-9f)
+			break;
+
+		for (int p = 0; p < 2; ++p)
+		{
+			for (int q = p + 1; q < 3; ++q)
+			{
+				if (std::abs(a[p][q]) < 1e-12f)
+					continue;
+
+				float const theta = (a[q][q] - a[p][p]) / (2.f * a[p][q]);
+				float const t = (theta >= 0.f ? 1.f : -1.f) / (std::abs(theta) + std::sqrt(theta * theta + 1.f));
+				float const c = 1.f / std::sqrt(t * t + 1.f);
+				float const s = t * c;
+
+				glm::mat3 j(1.f);
+				j[p][p] = c;
+				j[q][q] = c;
+				j[q][p] = s;
+				j[p][q] = -s;
+
+				a = glm::transpose(j) * a * j;
+				v = v * j;
+			}
+		}
+	}
+
+	return {v[0], v[1], v[2]};
+}
+
+static obb fit(std::vector<glm::vec3> const & points, std::array<glm::vec3, 3> axes)
+{
+	static constexpr float inf = std::numeric_limits<float>::infinity();
+
+	axes[2] = glm::cross(axes[0], axes[1]);
+
+	glm::vec3 min(inf);
+	glm::vec3 max(-inf);
+
+	for (auto const & p : points)
+	{
+		glm::vec3 v(glm::dot(p, axes[0]), glm::dot(p, axes[1]), glm::dot(p, axes[2]));
+		min = glm::min(min, v);
+		max = glm::max(max, v);
+	}
+
+	glm::vec3 const mid = (min + max) * 0.5f;
+	glm::vec3 const center = mid.x * axes[0] + mid.y * axes[1] + mid.z * axes[2];
+
+	return obb(center, axes, (max - min) * 0.5f);
+}
+
+static std::array<glm::vec3, 3> rotate_around(std::array<glm::vec3, 3> const & axes, int k, float angle)
+{
+	int const i = (k + 1) % 3;
+	int const j = (k + 2) % 3;
+
+	float const c = std::cos(angle);
+	float const s = std::sin(angle);
+
+	std::array<glm::vec3, 3> result = axes;
+	result[i] = c * axes[i] + s * axes[j];
+	result[j] = c * axes[j] - s * axes[i];
+	return result;
+}
+
+obb compute_obb(std::vector<glm::vec3> const & points)
+{
+	if (points.empty())
+		return obb(glm::vec3(0.f), {glm::vec3(1.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f), glm::vec3(0.f, 0.f, 1.f)}, glm::vec3(0.f));
+
+	glm::vec3 mean(0.f);
+	for (auto const & p : points)
+		mean += p;
+	mean /= float(points.size());
+
+	glm::mat3 covariance(0.f);
+	for (auto const & p : points)
+	{
+		glm::vec3 const d = p - mean;
+		for (int i = 0; i < 3; ++i)
+			for (int j = 0; j < 3; ++j)
+				covariance[i][j] += d[i] * d[j];
+	}
+
+	auto axes = eigenvectors(covariance);
+	for (auto & axis : axes)
+		axis = glm::normalize(axis);
+
+	obb best = fit(points, axes);
+
+	// PCA is only a heuristic (e.g. it is skewed by vertex density), so
+	// search for a better orientation around each of the current axes
+	for (int round = 0; round < 2; ++round)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			float const range = glm::pi<float>() / 4.f;
+			int const steps = 16;
+
+			float best_angle = 0.f;
+			float best_volume = best.volume();
+			auto const base_axes = best.axes;
+
+			for (int s = -steps; s <= steps; ++s)
+			{
+				float const angle = range * s / steps;
+				obb candidate = fit(points, rotate_around(base_axes, k, angle));
+				if (candidate.volume() < best_volume)
+				{
+					best_volume = candidate.volume();
+					best_angle = angle;
+				}
+			}
+
+			for (float step = range / steps / 2.f; step > 1e-4f; step /= 2.f)
+			{
+				for (float angle : {best_angle - step, best_angle + step})
+				{
+					obb candidate = fit(points, rotate_around(base_axes, k, angle));
+					if (candidate.volume() < best_volume)
+					{
+						best_volume = candidate.volume();
+						best_angle = angle;
+					}
+				}
+			}
+
+			if (best_angle != 0.f)
+				best = fit(points, rotate_around(base_axes, k, best_angle));
+		}
+	}
+
+	obb aligned = fit(points, {glm::vec3(1.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f), glm::vec3(0.f, 0.f, 1.f)});
+	if (aligned.volume() < best.volume())
+		return aligned;
+
+	return best;
+}
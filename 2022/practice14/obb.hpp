@@ -0,0 +1,30 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <array>
+#include <vector>
+
+struct obb
+{
+	obb(glm::vec3 const & center, std::array<glm::vec3, 3> const & axes, glm::vec3 const & half_extents);
+
+	glm::vec3 center;
+	std::array<glm::vec3, 3> axes;
+	glm::vec3 half_extents;
+
+	std::array<glm::vec3, 8> vertices;
+	std::array<glm::vec3, 3> face_normals;
+	std::array<glm::vec3, 3> edge_directions;
+
+	float volume() const;
+};
+
+// Box in the model space -> box in the world space, the transform is expected to be affine
+obb transform(obb const & box, glm::mat4 const & model);
+
+// Starts from the principal axes of the points and then refines them by
+// rotating the box around each of its axes, keeping the smallest volume found.
+// Falls back to the axis-aligned box if it happens to be smaller.
+obb compute_obb(std::vector<glm::vec3> const & points);
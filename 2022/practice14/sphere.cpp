@@ -0,0 +1,100 @@
+#include "sphere.hpp"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <random>
+#include <cmath>
+
+const std::array<glm::vec3, 0> sphere::face_normals = {};
+const std::array<glm::vec3, 0> sphere::edge_directions = {};
+
+std::pair<float, float> project(sphere const & s, glm::vec3 const & n)
+{
+	float const c = glm::dot(s.center, n);
+	float const r = s.radius * glm::length(n);
+	return {c - r, c + r};
+}
+
+sphere transform(sphere const & s, glm::mat4 const & model)
+{
+	float const scale = std::max({
+		glm::length(glm::vec3(model[0])),
+		glm::length(glm::vec3(model[1])),
+		glm::length(glm::vec3(model[2])),
+	});
+
+	return {glm::vec3(model * glm::vec4(s.center, 1.f)), s.radius * scale};
+}
+
+static void grow(sphere & s, glm::vec3 const & p)
+{
+	float const d = glm::distance(s.center, p);
+	if (d <= s.radius)
+		return;
+
+	float const radius = (s.radius + d) * 0.5f;
+	s.center += (p - s.center) * ((radius - s.radius) / d);
+	s.radius = radius;
+}
+
+static sphere ritter(std::vector<glm::vec3> const & points)
+{
+	// Pick the most separated pair among the extreme points along the coordinate axes
+	std::size_t min_i[3] = {0, 0, 0};
+	std::size_t max_i[3] = {0, 0, 0};
+
+	for (std::size_t i = 0; i < points.size(); ++i)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			if (points[i][k] < points[min_i[k]][k]) min_i[k] = i;
+			if (points[i][k] > points[max_i[k]][k]) max_i[k] = i;
+		}
+	}
+
+	int best = 0;
+	for (int k = 1; k < 3; ++k)
+	{
+		if (glm::distance(points[min_i[k]], points[max_i[k]]) > glm::distance(points[min_i[best]], points[max_i[best]]))
+			best = k;
+	}
+
+	glm::vec3 const a = points[min_i[best]];
+	glm::vec3 const b = points[max_i[best]];
+
+	sphere result{(a + b) * 0.5f, glm::distance(a, b) * 0.5f};
+
+	for (auto const & p : points)
+		grow(result, p);
+
+	return result;
+}
+
+sphere compute_bounding_sphere(std::vector<glm::vec3> const & points)
+{
+	if (points.empty())
+		return {glm::vec3(0.f), 0.f};
+
+	sphere best = ritter(points);
+
+	std::vector<glm::vec3> shuffled = points;
+
+	// Fixed seed keeps the bounds deterministic between runs
+	std::default_random_engine rng{42};
+
+	for (int pass = 0; pass < 8; ++pass)
+	{
+		sphere candidate{best.center, best.radius * 0.95f};
+
+		std::shuffle(shuffled.begin(), shuffled.end(), rng);
+
+		for (auto const & p : shuffled)
+			grow(candidate, p);
+
+		if (candidate.radius < best.radius)
+			best = candidate;
+	}
+
+	return best;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <array>
+#include <vector>
+#include <utility>
+
+struct sphere
+{
+	glm::vec3 center;
+	float radius;
+
+	// A sphere has no faces or edges of its own, so the separating axis test
+	// only uses the axes of the other body; this makes it conservative, which is
+	// exactly what culling needs
+	static const std::array<glm::vec3, 0> face_normals;
+	static const std::array<glm::vec3, 0> edge_directions;
+};
+
+// Overload of the generic projection from intersect.hpp, found through ADL
+std::pair<float, float> project(sphere const & s, glm::vec3 const & n);
+
+// Sphere in the model space -> sphere in the world space, the transform is expected to be affine
+sphere transform(sphere const & s, glm::mat4 const & model);
+
+// Ritter's sphere followed by a few shrink-and-regrow passes,
+// typically within a couple of percent of the minimal sphere
+sphere compute_bounding_sphere(std::vector<glm::vec3> const & points);
@@ -0,0 +1,169 @@
+#include "sweep_and_prune.hpp"
+
+#include <glm/common.hpp>
+
+#include <algorithm>
+
+std::uint32_t sweep_and_prune::add(glm::vec3 const & min, glm::vec3 const & max)
+{
+	std::uint32_t const body = mins.size();
+
+	mins.push_back(min);
+	maxs.push_back(max);
+	active_index.push_back(0);
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		endpoints[axis].push_back({min[axis], body, 0});
+		endpoints[axis].push_back({max[axis], body, 1});
+		needs_full_sort[axis] = true;
+	}
+
+	return body;
+}
+
+void sweep_and_prune::update(std::uint32_t body, glm::vec3 const & min, glm::vec3 const & max)
+{
+	mins[body] = min;
+	maxs[body] = max;
+}
+
+void sweep_and_prune::sort_axis(int axis)
+{
+	auto & list = endpoints[axis];
+
+	for (auto & e : list)
+		e.value = e.is_max ? maxs[e.body][axis] : mins[e.body][axis];
+
+	// Minimums go first on ties, so that touching boxes are reported
+	// just like the separating axis test does
+	auto less = [](endpoint const & e1, endpoint const & e2)
+	{
+		return (e1.value < e2.value) || (e1.value == e2.value && e1.is_max < e2.is_max);
+	};
+
+	// Freshly added bodies are in arbitrary order, insertion sort only pays off for small moves
+	if (needs_full_sort[axis])
+	{
+		std::sort(list.begin(), list.end(), less);
+		needs_full_sort[axis] = false;
+		return;
+	}
+
+	for (std::size_t i = 1; i < list.size(); ++i)
+	{
+		endpoint const e = list[i];
+
+		std::size_t j = i;
+		for (; j > 0 && less(e, list[j - 1]); --j)
+			list[j] = list[j - 1];
+
+		list[j] = e;
+	}
+}
+
+int sweep_and_prune::sweep_axis()
+{
+	// Sweeping along the axis with the largest spread of the
+	// boxes gives the fewest overlapping intervals to test
+	glm::vec3 sum(0.f);
+	glm::vec3 sum_squares(0.f);
+
+	for (std::size_t i = 0; i < mins.size(); ++i)
+	{
+		glm::vec3 const c = (mins[i] + maxs[i]) * 0.5f;
+		sum += c;
+		sum_squares += c * c;
+	}
+
+	glm::vec3 const variance = sum_squares - sum * sum / float(mins.size());
+
+	int best = 0;
+	for (int axis = 1; axis < 3; ++axis)
+		if (variance[axis] > variance[best])
+			best = axis;
+
+	if (current_axis < 0 || variance[best] > 1.5f * variance[current_axis])
+	{
+		// The other lists are not maintained, their order is arbitrary by now
+		if (best != current_axis)
+			needs_full_sort[best] = true;
+		current_axis = best;
+	}
+
+	return current_axis;
+}
+
+std::vector<std::pair<std::uint32_t, std::uint32_t>> const & sweep_and_prune::find_pairs()
+{
+	pairs.clear();
+
+	if (mins.empty())
+		return pairs;
+
+	int const axis = sweep_axis();
+	int const axis1 = (axis + 1) % 3;
+	int const axis2 = (axis + 2) % 3;
+
+	sort_axis(axis);
+
+	active.clear();
+	for (auto & bounds : active_bounds)
+		bounds.clear();
+
+	for (auto const & e : endpoints[axis])
+	{
+		std::uint32_t const i = e.body;
+
+		if (e.is_max)
+		{
+			std::uint32_t const index = active_index[i];
+			std::uint32_t const last = active.back();
+
+			active[index] = last;
+			active_index[last] = index;
+			active.pop_back();
+
+			for (auto & bounds : active_bounds)
+			{
+				bounds[index] = bounds.back();
+				bounds.pop_back();
+			}
+
+			continue;
+		}
+
+		float const min1 = mins[i][axis1];
+		float const max1 = maxs[i][axis1];
+		float const min2 = mins[i][axis2];
+		float const max2 = maxs[i][axis2];
+
+		std::size_t const count = active.size();
+
+		float const * other_min1 = active_bounds[0].data();
+		float const * other_max1 = active_bounds[1].data();
+		float const * other_min2 = active_bounds[2].data();
+		float const * other_max2 = active_bounds[3].data();
+
+		for (std::size_t k = 0; k < count; ++k)
+		{
+			// Evaluated without short-circuiting: the combined condition is
+			// almost always false and thus well predicted, unlike each part
+			bool const overlap =
+				(min1 <= other_max1[k]) & (other_min1[k] <= max1) &
+				(min2 <= other_max2[k]) & (other_min2[k] <= max2);
+
+			if (overlap)
+				pairs.emplace_back(std::min(i, active[k]), std::max(i, active[k]));
+		}
+
+		active_index[i] = count;
+		active.push_back(i);
+		active_bounds[0].push_back(min1);
+		active_bounds[1].push_back(max1);
+		active_bounds[2].push_back(min2);
+		active_bounds[3].push_back(max2);
+	}
+
+	return pairs;
+}
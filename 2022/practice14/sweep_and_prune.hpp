@@ -0,0 +1,54 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+// Broadphase over axis-aligned boxes. The endpoint lists are kept sorted
+// between frames and re-sorted with insertion sort, which is close to linear
+// when the bodies move a little each frame. The candidate pairs are meant to be
+// checked afterwards with the exact intersect() test.
+class sweep_and_prune
+{
+public:
+	std::uint32_t add(glm::vec3 const & min, glm::vec3 const & max);
+	void update(std::uint32_t body, glm::vec3 const & min, glm::vec3 const & max);
+
+	std::size_t size() const { return mins.size(); }
+
+	// Pairs of bodies whose boxes overlap, each pair is reported once with first < second
+	std::vector<std::pair<std::uint32_t, std::uint32_t>> const & find_pairs();
+
+private:
+	struct endpoint
+	{
+		float value;
+		std::uint32_t body : 31;
+		std::uint32_t is_max : 1;
+	};
+
+	std::vector<glm::vec3> mins;
+	std::vector<glm::vec3> maxs;
+
+	std::array<std::vector<endpoint>, 3> endpoints;
+	std::array<bool, 3> needs_full_sort = {false, false, false};
+
+	// Only the list of the sweep axis is kept sorted, so switching the axis
+	// costs a full sort of a stale list; the axis is kept until another one
+	// spreads the boxes noticeably wider
+	int current_axis = -1;
+
+	// The extents of the active boxes along the two other axes are copied
+	// into separate arrays, so that the inner loop of the sweep reads memory
+	// sequentially
+	std::vector<std::uint32_t> active;
+	std::array<std::vector<float>, 4> active_bounds;
+	std::vector<std::uint32_t> active_index;
+	std::vector<std::pair<std::uint32_t, std::uint32_t>> pairs;
+
+	void sort_axis(int axis);
+	int sweep_axis();
+};
@@ -1,22 +1,31 @@
 #include "msdf_loader.hpp"
 
 #include <rapidjson/document.h>
-#include <rapidjson/istreamwrapper.h>
 
 #include <fstream>
 #include <stdexcept>
 #include <filesystem>
+#include <vector>
+#include <string_view>
+#include <optional>
 
 msdf_font load_msdf_font(std::string const & path)
 {
-    rapidjson::Document document;
+    // The text is parsed in place: the DOM strings point into
+    // this buffer instead of being allocated one by one
+    std::vector<char> text(std::filesystem::file_size(path) + 1, '\0');
 
     {
         std::ifstream input(path, std::ios::binary);
-        rapidjson::IStreamWrapper stream(input);
-        document.ParseStream(stream);
+        if (!input.read(text.data(), text.size() - 1))
+            throw std::runtime_error("Failed to read " + path);
     }
 
+    rapidjson::Document document;
+    document.ParseInsitu(text.data());
+    if (document.HasParseError())
+        throw std::runtime_error("Failed to parse " + path);
+
     msdf_font result;
 
     {
@@ -31,19 +40,38 @@ msdf_font load_msdf_font(std::string const & path)
     }
 
     auto chars = document["chars"].GetArray();
+    result.glyphs.reserve(chars.Size());
 
     for (auto const & charInfo : chars)
     {
-        char32_t id = charInfo["id"].GetUint();
-
-        auto & data = result.glyphs[id];
-        data.x = charInfo["x"].GetInt();
-        data.y = charInfo["y"].GetInt();
-        data.width = charInfo["width"].GetInt();
-        data.height = charInfo["height"].GetInt();
-        data.xoffset = charInfo["xoffset"].GetInt();
-        data.yoffset = charInfo["yoffset"].GetInt();
-        data.advance = charInfo["xadvance"].GetInt();
+        msdf_font::glyph data{};
+        std::optional<char32_t> id;
+
+        // A single pass over the members instead of a lookup for each one
+        for (auto const & member : charInfo.GetObject())
+        {
+            std::string_view const name(member.name.GetString(), member.name.GetStringLength());
+
+            if (name == "id")
+            {
+                if (!member.value.IsUint())
+                    throw std::runtime_error("Glyph id is not an unsigned integer in " + path);
+                id = member.value.GetUint();
+            }
+            else if (name == "x") data.x = member.value.GetInt();
+            else if (name == "y") data.y = member.value.GetInt();
+            else if (name == "width") data.width = member.value.GetInt();
+            else if (name == "height") data.height = member.value.GetInt();
+            else if (name == "xoffset") data.xoffset = member.value.GetInt();
+            else if (name == "yoffset") data.yoffset = member.value.GetInt();
+            else if (name == "xadvance") data.advance = member.value.GetInt();
+        }
+
+        // Defaulting it to 0 would silently overwrite that glyph
+        if (!id)
+            throw std::runtime_error("Glyph without an id in " + path);
+
+        result.glyphs[*id] = data;
     }
 
     return result;
@@ -16,9 +16,9 @@
 #include <cmath>
 #include <fstream>
 #include <sstream>
+#include <limits>
+#include <algorithm>
 
-#define GLM_FORCE_SWIZZLE
-#define GLM_ENABLE_EXPERIMENTAL
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
 #include <glm/ext/matrix_transform.hpp>
@@ -27,6 +27,9 @@
 #include <glm/gtx/string_cast.hpp>
 
 #include "obj_parser.hpp"
+#include "aabb.hpp"
+#include "intersect.hpp"
+#include "shadow_cascades.hpp"
 
 std::string to_string(std::string_view str)
 {
@@ -55,11 +58,13 @@ layout (location = 1) in vec3 in_normal;
 
 out vec3 position;
 out vec3 normal;
+out float view_depth;
 
 void main()
 {
     gl_Position = projection * view * model * vec4(in_position, 1.0);
     position = (model * vec4(in_position, 1.0)).xyz;
+    view_depth = -(view * model * vec4(in_position, 1.0)).z;
     normal = normalize((model * vec4(in_normal, 0.0)).xyz);
 }
 )";
@@ -72,25 +77,31 @@ uniform vec3 ambient;
 uniform vec3 light_direction;
 uniform vec3 light_color;
 
-uniform mat4 transform;
+uniform mat4 transform[4];
+uniform float cascade_far[4];
 
-uniform sampler2D shadow_map;
+uniform sampler2DArray shadow_map;
 
 in vec3 position;
 in vec3 normal;
+in float view_depth;
 
 layout (location = 0) out vec4 out_color;
 
 void main()
 {
-    vec4 shadow_pos = transform * vec4(position, 1.0);
+    int cascade = 0;
+    while (cascade < 3 && view_depth > cascade_far[cascade])
+        ++cascade;
+
+    vec4 shadow_pos = transform[cascade] * vec4(position, 1.0);
     shadow_pos /= shadow_pos.w;
     shadow_pos = shadow_pos * 0.5 + vec4(0.5);
 
     bool in_shadow_texture = (shadow_pos.x > 0.0) && (shadow_pos.x < 1.0) && (shadow_pos.y > 0.0) && (shadow_pos.y < 1.0) && (shadow_pos.z > 0.0) && (shadow_pos.z < 1.0);
     float shadow_factor = 1.0;
     if (in_shadow_texture)
-        shadow_factor = (texture(shadow_map, shadow_pos.xy).r < shadow_pos.z) ? 0.0 : 1.0;
+        shadow_factor = (texture(shadow_map, vec3(shadow_pos.xy, float(cascade))).r < shadow_pos.z) ? 0.0 : 1.0;
 
     vec3 albedo = vec3(1.0, 1.0, 1.0);
 
@@ -127,7 +138,7 @@ void main()
 const char debug_fragment_shader_source[] =
 R"(#version 330 core
 
-uniform sampler2D shadow_map;
+uniform sampler2DArray shadow_map;
 
 in vec2 texcoord;
 
@@ -135,7 +146,7 @@ layout (location = 0) out vec4 out_color;
 
 void main()
 {
-    out_color = vec4(texture(shadow_map, texcoord).rrr, 1.0);
+    out_color = vec4(texture(shadow_map, vec3(texcoord, 0.0)).rrr, 1.0);
 }
 )";
 
@@ -243,6 +254,7 @@ int main() try
     GLuint view_location = glGetUniformLocation(program, "view");
     GLuint projection_location = glGetUniformLocation(program, "projection");
     GLuint transform_location = glGetUniformLocation(program, "transform");
+    GLuint cascade_far_location = glGetUniformLocation(program, "cascade_far");
 
     GLuint ambient_location = glGetUniformLocation(program, "ambient");
     GLuint light_direction_location = glGetUniformLocation(program, "light_direction");
@@ -273,6 +285,36 @@ int main() try
     std::string scene_path = project_root + "/bunny.obj";
     obj_data scene = parse_obj(scene_path);
 
+    glm::vec3 scene_min(std::numeric_limits<float>::infinity());
+    glm::vec3 scene_max(-std::numeric_limits<float>::infinity());
+    for (auto const & v : scene.vertices)
+    {
+        glm::vec3 p(v.position[0], v.position[1], v.position[2]);
+        scene_min = glm::min(scene_min, p);
+        scene_max = glm::max(scene_max, p);
+    }
+    aabb const scene_bounds(scene_min, scene_max);
+
+    // The scene is split into runs of triangles with their own bounds, so
+    // that each cascade only draws the casters that can reach it
+    std::size_t const caster_triangles = 4096;
+    std::vector<aabb> casters;
+    for (std::size_t begin = 0; begin < scene.indices.size(); begin += 3 * caster_triangles)
+    {
+        std::size_t const end = std::min(scene.indices.size(), begin + 3 * caster_triangles);
+
+        glm::vec3 caster_min(std::numeric_limits<float>::infinity());
+        glm::vec3 caster_max(-std::numeric_limits<float>::infinity());
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            auto const & v = scene.vertices[scene.indices[i]];
+            glm::vec3 p(v.position[0], v.position[1], v.position[2]);
+            caster_min = glm::min(caster_min, p);
+            caster_max = glm::max(caster_max, p);
+        }
+        casters.emplace_back(caster_min, caster_max);
+    }
+
     GLuint vao, vbo, ebo;
     glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
@@ -294,20 +336,21 @@ int main() try
     glGenVertexArrays(1, &debug_vao);
 
     GLsizei shadow_map_resolution = 1024;
+    std::size_t const cascade_count = 4;
 
     GLuint shadow_map;
     glGenTextures(1, &shadow_map);
-    glBindTexture(GL_TEXTURE_2D, shadow_map);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, shadow_map_resolution, shadow_map_resolution, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, shadow_map);
+    glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, shadow_map_resolution, shadow_map_resolution, cascade_count, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
 
     GLuint shadow_fbo;
     glGenFramebuffers(1, &shadow_fbo);
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadow_fbo);
-    glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadow_map, 0);
+    glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadow_map, 0, 0);
     if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         throw std::runtime_error("Incomplete framebuffer!");
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
@@ -374,8 +417,23 @@ int main() try
 
         glm::vec3 light_direction = glm::normalize(glm::vec3(std::cos(time * 0.5f), 1.f, std::sin(time * 0.5f)));
 
+        float near = 0.01f;
+        float far = 10.f;
+        float fov = glm::pi<float>() / 2.f;
+        float aspect = (1.f * width) / height;
+
+        glm::mat4 view(1.f);
+        view = glm::translate(view, {0.f, 0.f, -camera_distance});
+        view = glm::rotate(view, view_elevation, {1.f, 0.f, 0.f});
+        view = glm::rotate(view, view_azimuth, {0.f, 1.f, 0.f});
+
+        glm::mat4 projection = glm::mat4(1.f);
+        projection = glm::perspective(fov, aspect, near, far);
+
+        auto const cascades = fit_cascades(view, fov, aspect, cascade_splits(near, far, cascade_count, 0.75f),
+            light_direction, scene_bounds, shadow_map_resolution);
+
         glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadow_fbo);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         glViewport(0, 0, shadow_map_resolution, shadow_map_resolution);
 
         glEnable(GL_DEPTH_TEST);
@@ -384,28 +442,37 @@ int main() try
         glEnable(GL_CULL_FACE);
         glCullFace(GL_BACK);
 
-        glm::vec3 light_z = -light_direction;
-        glm::vec3 light_x = glm::normalize(glm::cross(light_z, {0.f, 1.f, 0.f}));
-        glm::vec3 light_y = glm::cross(light_x, light_z);
-        float shadow_scale = 2.f;
+        glUseProgram(shadow_program);
+        glUniformMatrix4fv(shadow_model_location, 1, GL_FALSE, reinterpret_cast<float *>(&model));
 
-        glm::mat4 transform = glm::mat4(1.f);
-        for (size_t i = 0; i < 3; ++i)
+        std::vector<glm::mat4> transforms;
+        std::vector<float> cascade_far;
+        for (std::size_t i = 0; i < cascades.size(); ++i)
         {
-            transform[i][0] = shadow_scale * light_x[i];
-            transform[i][1] = shadow_scale * light_y[i];
-            transform[i][2] = shadow_scale * light_z[i];
-        }
+            auto const & cascade = cascades[i];
+            transforms.push_back(cascade.transform);
+            cascade_far.push_back(cascade.far);
 
-        glUseProgram(shadow_program);
-        glUniformMatrix4fv(shadow_model_location, 1, GL_FALSE, reinterpret_cast<float *>(&model));
-        glUniformMatrix4fv(shadow_transform_location, 1, GL_FALSE, reinterpret_cast<float *>(&transform));
+            glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadow_map, 0, i);
+            glClear(GL_DEPTH_BUFFER_BIT);
 
-        glBindVertexArray(vao);
-        glDrawElements(GL_TRIANGLES, scene.indices.size(), GL_UNSIGNED_INT, nullptr);
+            auto const visible_casters = cull_shadow_casters(cascade, casters);
+            if (visible_casters.empty())
+                continue;
+
+            glUniformMatrix4fv(shadow_transform_location, 1, GL_FALSE, reinterpret_cast<float const *>(&cascade.transform));
+
+            glBindVertexArray(vao);
+            for (auto caster : visible_casters)
+            {
+                std::size_t const begin = 3 * caster_triangles * caster;
+                std::size_t const count = std::min(scene.indices.size() - begin, 3 * caster_triangles);
+                glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, reinterpret_cast<void *>(begin * sizeof(scene.indices[0])));
+            }
+        }
 
-        glBindTexture(GL_TEXTURE_2D, shadow_map);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, shadow_map);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
 
         glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
         glViewport(0, 0, width, height);
@@ -419,24 +486,14 @@ int main() try
         glEnable(GL_CULL_FACE);
         glCullFace(GL_BACK);
 
-        float near = 0.01f;
-        float far = 10.f;
-
-        glm::mat4 view(1.f);
-        view = glm::translate(view, {0.f, 0.f, -camera_distance});
-        view = glm::rotate(view, view_elevation, {1.f, 0.f, 0.f});
-        view = glm::rotate(view, view_azimuth, {0.f, 1.f, 0.f});
-
-        glm::mat4 projection = glm::mat4(1.f);
-        projection = glm::perspective(glm::pi<float>() / 2.f, (1.f * width) / height, near, far);
-
-        glBindTexture(GL_TEXTURE_2D, shadow_map);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, shadow_map);
 
         glUseProgram(program);
         glUniformMatrix4fv(model_location, 1, GL_FALSE, reinterpret_cast<float *>(&model));
         glUniformMatrix4fv(view_location, 1, GL_FALSE, reinterpret_cast<float *>(&view));
         glUniformMatrix4fv(projection_location, 1, GL_FALSE, reinterpret_cast<float *>(&projection));
-        glUniformMatrix4fv(transform_location, 1, GL_FALSE, reinterpret_cast<float *>(&transform));
+        glUniformMatrix4fv(transform_location, transforms.size(), GL_FALSE, reinterpret_cast<float *>(transforms.data()));
+        glUniform1fv(cascade_far_location, cascade_far.size(), cascade_far.data());
 
         glUniform3f(ambient_location, 0.2f, 0.2f, 0.2f);
         glUniform3fv(light_direction_location, 1, reinterpret_cast<float *>(&light_direction));
@@ -446,7 +503,7 @@ int main() try
         glDrawElements(GL_TRIANGLES, scene.indices.size(), GL_UNSIGNED_INT, nullptr);
 
         glUseProgram(debug_program);
-        glBindTexture(GL_TEXTURE_2D, shadow_map);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, shadow_map);
         glBindVertexArray(debug_vao);
         glDrawArrays(GL_TRIANGLES, 0, 6);
 
@@ -0,0 +1,103 @@
+#include "shadow_cascades.hpp"
+#include "intersect.hpp"
+
+#include <glm/geometric.hpp>
+#include <glm/ext/matrix_clip_space.hpp>
+
+#include <cmath>
+#include <limits>
+
+std::vector<float> cascade_splits(float near, float far, std::size_t count, float lambda)
+{
+	std::vector<float> result(count + 1);
+
+	for (std::size_t i = 0; i <= count; ++i)
+	{
+		float const s = (1.f * i) / count;
+		float const log_split = near * std::pow(far / near, s);
+		float const uniform_split = near + (far - near) * s;
+		result[i] = lambda * log_split + (1.f - lambda) * uniform_split;
+	}
+
+	result.front() = near;
+	result.back() = far;
+
+	return result;
+}
+
+std::vector<shadow_cascade> fit_cascades(glm::mat4 const & view, float fov_y, float aspect, std::vector<float> const & splits,
+	glm::vec3 const & light_direction, aabb const & scene_bounds, std::size_t resolution)
+{
+	static constexpr float inf = std::numeric_limits<float>::infinity();
+
+	glm::vec3 light_z = -light_direction;
+	glm::vec3 light_x = glm::normalize(glm::cross(light_z, {0.f, 1.f, 0.f}));
+	glm::vec3 light_y = glm::cross(light_x, light_z);
+
+	float scene_min_z = inf;
+	float scene_max_z = -inf;
+	for (auto const & p : scene_bounds.vertices)
+	{
+		scene_min_z = std::min(scene_min_z, glm::dot(light_z, p));
+		scene_max_z = std::max(scene_max_z, glm::dot(light_z, p));
+	}
+
+	std::vector<shadow_cascade> result;
+	result.reserve(splits.size() - 1);
+
+	for (std::size_t i = 0; i + 1 < splits.size(); ++i)
+	{
+		frustum slice(glm::perspective(fov_y, aspect, splits[i], splits[i + 1]) * view);
+
+		glm::vec3 center(0.f);
+		for (auto const & p : slice.vertices)
+			center += p;
+		center /= 8.f;
+
+		float radius = 0.f;
+		for (auto const & p : slice.vertices)
+			radius = std::max(radius, glm::distance(center, p));
+
+		// The sphere doesn't depend on the camera orientation, and quantizing its radius
+		// keeps the projection scale fixed under small changes of the field of view
+		radius = std::ceil(radius * 16.f) / 16.f;
+
+		float const texel = 2.f * radius / resolution;
+		float const center_x = std::floor(glm::dot(light_x, center) / texel) * texel;
+		float const center_y = std::floor(glm::dot(light_y, center) / texel) * texel;
+
+		float min_z = scene_min_z;
+		float max_z = scene_max_z;
+		for (auto const & p : slice.vertices)
+		{
+			min_z = std::min(min_z, glm::dot(light_z, p));
+			max_z = std::max(max_z, glm::dot(light_z, p));
+		}
+
+		glm::mat4 transform(1.f);
+		for (std::size_t j = 0; j < 3; ++j)
+		{
+			transform[j][0] = light_x[j] / radius;
+			transform[j][1] = light_y[j] / radius;
+			transform[j][2] = 2.f * light_z[j] / (max_z - min_z);
+		}
+		transform[3][0] = - center_x / radius;
+		transform[3][1] = - center_y / radius;
+		transform[3][2] = - (max_z + min_z) / (max_z - min_z);
+
+		result.push_back({splits[i], splits[i + 1], transform, frustum(transform)});
+	}
+
+	return result;
+}
+
+std::vector<std::size_t> cull_shadow_casters(shadow_cascade const & cascade, std::vector<aabb> const & casters)
+{
+	std::vector<std::size_t> result;
+
+	for (std::size_t i = 0; i < casters.size(); ++i)
+		if (intersect(cascade.volume, casters[i]))
+			result.push_back(i);
+
+	return result;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <vector>
+
+#include "aabb.hpp"
+#include "frustum.hpp"
+
+struct shadow_cascade
+{
+	// View-space depth range of the camera frustum slice covered by this cascade
+	float near;
+	float far;
+
+	// World space -> shadow map clip space, same convention as the single shadow map transform
+	glm::mat4 transform;
+
+	// The light-space box covered by the shadow map, used for caster culling
+	frustum volume;
+};
+
+// Practical split scheme: lambda = 0 gives uniform splits, lambda = 1 gives logarithmic splits.
+// Returns count + 1 distances, the first one being near and the last one being far.
+std::vector<float> cascade_splits(float near, float far, std::size_t count, float lambda);
+
+// Fits an orthographic light projection around each camera frustum slice. The projection is
+// built around the bounding sphere of the slice and snapped to shadow map texels, so it
+// doesn't shimmer when the camera moves or rotates. The depth range is extended to the
+// scene bounds so that casters outside of the slice still land in the shadow map.
+std::vector<shadow_cascade> fit_cascades(glm::mat4 const & view, float fov_y, float aspect, std::vector<float> const & splits,
+	glm::vec3 const & light_direction, aabb const & scene_bounds, std::size_t resolution);
+
+// Indices of the casters that can throw a shadow into the cascade
+std::vector<std::size_t> cull_shadow_casters(shadow_cascade const & cascade, std::vector<aabb> const & casters);